@@ -0,0 +1,75 @@
+// Reads the state a chip8 instance exports with --shm and prints it.
+//
+//   chip8 --shm /chip8 rom.ch8 &
+//   shm_reader /chip8 [samples]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "Share/SharedState.h"
+
+static void print_snapshot(const SharedSnapshot *snapshot)
+{
+    const VM *vm = &snapshot->vm;
+
+    printf("frame %llu  cycles %llu  PC %03zX  I %03X  DT %02X  ST %02X\n",
+           (unsigned long long)snapshot->frame,
+           (unsigned long long)vm->cycles,
+           vm->program_counter,
+           vm->index_register,
+           vm->delay_timer,
+           vm->sound_timer);
+
+    for (int i = 0; i < VM_VARIABLE_REGISTER_COUNT; i++)
+    {
+        printf("V%X %02X%s", i, vm->variable_registers[i], i % 8 == 7 ? "\n" : "  ");
+    }
+
+    for (int y = 0; y < VM_DISPLAY_HEIGHT; y++)
+    {
+        for (int x = 0; x < VM_DISPLAY_WIDTH; x++)
+        {
+            putchar(vm->display.pixels[y][x] ? '#' : '.');
+        }
+        putchar('\n');
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf("Usage: shm_reader <segment-name> [samples]\n");
+        return 0;
+    }
+
+    int samples = argc > 2 ? atoi(argv[2]) : 1;
+
+    const SharedState *state = shared_state_attach(argv[1]);
+    if (state == NULL)
+    {
+        return 1;
+    }
+
+    SharedSnapshot *snapshot = malloc(sizeof(SharedSnapshot));
+    for (int i = 0; i < samples; i++)
+    {
+        if (!shared_state_read(state, snapshot))
+        {
+            fprintf(stderr, "ERROR: No consistent snapshot, the emulator kept writing.\n");
+            free(snapshot);
+            shared_state_detach(state);
+            return 1;
+        }
+
+        print_snapshot(snapshot);
+
+        struct timespec delay = {0, 100 * 1000 * 1000};
+        nanosleep(&delay, NULL);
+    }
+
+    free(snapshot);
+    shared_state_detach(state);
+    return 0;
+}
@@ -0,0 +1,88 @@
+// Watches a chip8 instance started with --serve and draws it in the terminal.
+//
+//   chip8 --serve unix:/tmp/chip8.sock rom.ch8 &
+//   stream_viewer unix:/tmp/chip8.sock [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "Stream/StreamProtocol.h"
+
+static int read_exact(int fd, uint8_t *buffer, size_t length)
+{
+    size_t received = 0;
+    while (received < length)
+    {
+        ssize_t count = read(fd, &buffer[received], length - received);
+        if (count <= 0)
+        {
+            return 1;
+        }
+        received += (size_t)count;
+    }
+    return 0;
+}
+
+static void draw(const uint64_t rows[VM_DISPLAY_HEIGHT], uint32_t frame)
+{
+    printf("\x1b[H");
+    for (int y = 0; y < VM_DISPLAY_HEIGHT; y++)
+    {
+        for (int x = 0; x < VM_DISPLAY_WIDTH; x++)
+        {
+            putchar((rows[y] >> x) & 1 ? '#' : ' ');
+        }
+        putchar('\n');
+    }
+    printf("frame %u\n", frame);
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf("Usage: stream_viewer <unix:PATH|tcp:HOST:PORT> [frames]\n");
+        return 0;
+    }
+
+    long frames = argc > 2 ? atol(argv[2]) : -1;
+
+    int fd = stream_socket_open(argv[1], false);
+    if (fd < 0)
+    {
+        return 1;
+    }
+
+    uint64_t rows[VM_DISPLAY_HEIGHT] = {0};
+    uint8_t header_data[STREAM_HEADER_SIZE];
+    uint8_t payload[STREAM_PAYLOAD_MAX];
+
+    printf("\x1b[2J");
+    for (long received = 0; frames < 0 || received < frames; received++)
+    {
+        StreamHeader header;
+        if (read_exact(fd, header_data, sizeof(header_data)) != 0)
+        {
+            break;
+        }
+
+        if (stream_decode_header(header_data, &header) != 0 ||
+            read_exact(fd, payload, header.length) != 0 ||
+            stream_apply_delta(&header, payload, rows) != 0)
+        {
+            fprintf(stderr, "ERROR: Malformed stream message.\n");
+            close(fd);
+            return 1;
+        }
+
+        draw(rows, header.frame);
+    }
+
+    close(fd);
+    return 0;
+}
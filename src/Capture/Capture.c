@@ -0,0 +1,351 @@
+#include "Capture.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CAPTURE_Y4M_BLACK 16
+#define CAPTURE_Y4M_WHITE 235
+#define CAPTURE_ROW_BYTES (VM_DISPLAY_WIDTH / 8)
+
+const char *capture_format_to_cstr(CaptureFormat format)
+{
+    switch (format)
+    {
+    case CAPTURE_Y4M:
+        return "y4m";
+    case CAPTURE_RAW:
+        return "raw";
+    case CAPTURE_PNG:
+        return "png";
+    default:
+        return "capture_format_to_cstr unknown format";
+    }
+}
+
+int capture_format_from_cstr(const char *name, CaptureFormat *format)
+{
+    for (int i = CAPTURE_Y4M; i <= CAPTURE_PNG; i++)
+    {
+        if (strcmp(name, capture_format_to_cstr((CaptureFormat)i)) == 0)
+        {
+            *format = (CaptureFormat)i;
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// Row bytes the way CHIP-8 sprites store them, leftmost pixel in the most significant bit
+static void capture_row_bytes(uint64_t row, uint8_t bytes[CAPTURE_ROW_BYTES])
+{
+    for (int i = 0; i < CAPTURE_ROW_BYTES; i++)
+    {
+        uint8_t value = (uint8_t)(row >> (i * 8));
+        value = (uint8_t)(((value & 0xF0) >> 4) | ((value & 0x0F) << 4));
+        value = (uint8_t)(((value & 0xCC) >> 2) | ((value & 0x33) << 2));
+        value = (uint8_t)(((value & 0xAA) >> 1) | ((value & 0x55) << 1));
+        bytes[i] = value;
+    }
+}
+
+static uint32_t capture_crc32(uint32_t crc, const uint8_t *data, size_t length)
+{
+    static uint32_t table[256];
+    static bool table_ready = false;
+
+    if (!table_ready)
+    {
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+            {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        table_ready = true;
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void capture_put_u32(uint8_t *out, uint32_t value)
+{
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)value;
+}
+
+static int capture_write_png_chunk(FILE *file, const char *type, const uint8_t *data, uint32_t length)
+{
+    uint8_t header[8];
+    capture_put_u32(header, length);
+    memcpy(&header[4], type, 4);
+
+    uint8_t crc[4];
+    capture_put_u32(crc, capture_crc32(capture_crc32(0, (const uint8_t *)type, 4), data, length));
+
+    if (fwrite(header, 1, sizeof(header), file) != sizeof(header) ||
+        fwrite(data, 1, length, file) != length ||
+        fwrite(crc, 1, sizeof(crc), file) != sizeof(crc))
+    {
+        return 1;
+    }
+    return 0;
+}
+
+// 1 bit grayscale PNG, the image data is small enough to go into a single stored deflate block
+static int capture_write_png(Capture *capture, const CaptureFrame *frame)
+{
+    char filename[1024];
+    snprintf(filename, sizeof(filename), "%s%06llu.png", capture->path, (unsigned long long)capture->frames_written);
+
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "ERROR: Unable to open capture file %s.\n", filename);
+        return 1;
+    }
+
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+    uint8_t ihdr[13] = {0};
+    capture_put_u32(&ihdr[0], VM_DISPLAY_WIDTH);
+    capture_put_u32(&ihdr[4], VM_DISPLAY_HEIGHT);
+    ihdr[8] = 1; // bit depth
+    ihdr[9] = 0; // grayscale
+
+    enum
+    {
+        SCANLINES_SIZE = VM_DISPLAY_HEIGHT * (1 + CAPTURE_ROW_BYTES)
+    };
+    uint8_t idat[2 + 5 + SCANLINES_SIZE + 4];
+    uint8_t *scanlines = &idat[7];
+    idat[0] = 0x78;
+    idat[1] = 0x01;
+    idat[2] = 0x01; // final stored block
+    idat[3] = (uint8_t)(SCANLINES_SIZE & 0xFF);
+    idat[4] = (uint8_t)(SCANLINES_SIZE >> 8);
+    idat[5] = (uint8_t)(~SCANLINES_SIZE & 0xFF);
+    idat[6] = (uint8_t)((~SCANLINES_SIZE >> 8) & 0xFF);
+
+    for (int y = 0; y < VM_DISPLAY_HEIGHT; y++)
+    {
+        uint8_t *line = &scanlines[y * (1 + CAPTURE_ROW_BYTES)];
+        line[0] = 0; // no filter
+        capture_row_bytes(frame->rows[y], &line[1]);
+    }
+
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < SCANLINES_SIZE; i++)
+    {
+        a = (a + scanlines[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    capture_put_u32(&idat[7 + SCANLINES_SIZE], (b << 16) | a);
+
+    int error = fwrite(signature, 1, sizeof(signature), file) != sizeof(signature);
+    error = error || capture_write_png_chunk(file, "IHDR", ihdr, sizeof(ihdr));
+    error = error || capture_write_png_chunk(file, "IDAT", idat, sizeof(idat));
+    error = error || capture_write_png_chunk(file, "IEND", NULL, 0);
+
+    if (fclose(file) != 0)
+    {
+        error = 1;
+    }
+    return error;
+}
+
+static int capture_write_frame(Capture *capture, const CaptureFrame *frame)
+{
+    switch (capture->format)
+    {
+    case CAPTURE_Y4M:
+    {
+        uint8_t luma[VM_DISPLAY_HEIGHT * VM_DISPLAY_WIDTH];
+        for (int y = 0; y < VM_DISPLAY_HEIGHT; y++)
+        {
+            for (int x = 0; x < VM_DISPLAY_WIDTH; x++)
+            {
+                luma[y * VM_DISPLAY_WIDTH + x] = ((frame->rows[y] >> x) & 1) ? CAPTURE_Y4M_WHITE : CAPTURE_Y4M_BLACK;
+            }
+        }
+
+        if (fputs("FRAME\n", capture->file) < 0 || fwrite(luma, 1, sizeof(luma), capture->file) != sizeof(luma))
+        {
+            return 1;
+        }
+        return 0;
+    }
+    case CAPTURE_RAW:
+    {
+        uint8_t packed[VM_DISPLAY_HEIGHT * CAPTURE_ROW_BYTES];
+        for (int y = 0; y < VM_DISPLAY_HEIGHT; y++)
+        {
+            capture_row_bytes(frame->rows[y], &packed[y * CAPTURE_ROW_BYTES]);
+        }
+        return fwrite(packed, 1, sizeof(packed), capture->file) != sizeof(packed);
+    }
+    case CAPTURE_PNG:
+        return capture_write_png(capture, frame);
+    default:
+        return 1;
+    }
+}
+
+static void *capture_thread(void *argument)
+{
+    Capture *capture = argument;
+
+    pthread_mutex_lock(&capture->lock);
+    for (;;)
+    {
+        while (capture->front_count == 0 && !capture->stopping)
+        {
+            pthread_cond_wait(&capture->ready, &capture->lock);
+        }
+
+        if (capture->front_count == 0)
+        {
+            break;
+        }
+
+        CaptureFrame *batch = capture->front;
+        size_t count = capture->front_count;
+        capture->front = capture->back;
+        capture->back = batch;
+        capture->front_count = 0;
+        pthread_cond_signal(&capture->drained);
+        pthread_mutex_unlock(&capture->lock);
+
+        for (size_t i = 0; i < count && capture->error == 0; i++)
+        {
+            if (capture_write_frame(capture, &batch[i]) != 0)
+            {
+                fprintf(stderr, "ERROR: Failed to write capture frame %llu.\n", (unsigned long long)capture->frames_written);
+                capture->error = 1;
+            }
+            capture->frames_written++;
+        }
+
+        pthread_mutex_lock(&capture->lock);
+    }
+    pthread_mutex_unlock(&capture->lock);
+
+    return NULL;
+}
+
+Capture *capture_open(const char *path, CaptureFormat format, bool lossless)
+{
+    Capture *capture = calloc(1, sizeof(Capture));
+    if (capture == NULL)
+    {
+        return NULL;
+    }
+
+    capture->format = format;
+    capture->path = path;
+    capture->lossless = lossless;
+    capture->front = capture->batches[0];
+    capture->back = capture->batches[1];
+
+    if (format != CAPTURE_PNG)
+    {
+        capture->file = fopen(path, "wb");
+        if (capture->file == NULL)
+        {
+            fprintf(stderr, "ERROR: Unable to open capture file %s.\n", path);
+            free(capture);
+            return NULL;
+        }
+    }
+
+    if (format == CAPTURE_Y4M)
+    {
+        fprintf(capture->file, "YUV4MPEG2 W%i H%i F60:1 Ip A1:1 Cmono\n", VM_DISPLAY_WIDTH, VM_DISPLAY_HEIGHT);
+    }
+
+    pthread_mutex_init(&capture->lock, NULL);
+    pthread_cond_init(&capture->ready, NULL);
+    pthread_cond_init(&capture->drained, NULL);
+
+    if (pthread_create(&capture->thread, NULL, capture_thread, capture) != 0)
+    {
+        fprintf(stderr, "ERROR: Failed to start capture thread.\n");
+        pthread_cond_destroy(&capture->drained);
+        pthread_cond_destroy(&capture->ready);
+        pthread_mutex_destroy(&capture->lock);
+        if (capture->file != NULL)
+        {
+            fclose(capture->file);
+        }
+        free(capture);
+        return NULL;
+    }
+
+    return capture;
+}
+
+void capture_frame(Capture *capture, const Display *display)
+{
+    CaptureFrame frame;
+    display_pack_rows(display, frame.rows);
+
+    pthread_mutex_lock(&capture->lock);
+    while (capture->lossless && capture->front_count >= CAPTURE_BATCH_FRAMES)
+    {
+        pthread_cond_wait(&capture->drained, &capture->lock);
+    }
+
+    if (capture->front_count < CAPTURE_BATCH_FRAMES)
+    {
+        capture->front[capture->front_count++] = frame;
+        pthread_cond_signal(&capture->ready);
+    }
+    else
+    {
+        // The writer fell a whole batch behind, drop rather than stall emulation
+        capture->frames_dropped++;
+    }
+    pthread_mutex_unlock(&capture->lock);
+}
+
+int capture_close(Capture *capture)
+{
+    if (capture == NULL)
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&capture->lock);
+    capture->stopping = true;
+    pthread_cond_signal(&capture->ready);
+    pthread_mutex_unlock(&capture->lock);
+    pthread_join(capture->thread, NULL);
+
+    pthread_cond_destroy(&capture->drained);
+    pthread_cond_destroy(&capture->ready);
+    pthread_mutex_destroy(&capture->lock);
+
+    int error = capture->error;
+    if (capture->file != NULL && fclose(capture->file) != 0)
+    {
+        error = 1;
+    }
+
+    printf("Captured %llu frames to %s (%llu dropped)\n",
+           (unsigned long long)capture->frames_written,
+           capture->path,
+           (unsigned long long)capture->frames_dropped);
+
+    free(capture);
+    return error;
+}
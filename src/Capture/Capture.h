@@ -0,0 +1,56 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../VM/Display.h"
+
+#define CAPTURE_BATCH_FRAMES 64
+
+typedef enum CaptureFormat
+{
+    CAPTURE_Y4M = 0,
+    CAPTURE_RAW,
+    CAPTURE_PNG
+} CaptureFormat;
+
+typedef struct
+{
+    uint64_t rows[VM_DISPLAY_HEIGHT];
+} CaptureFrame;
+
+// Frames are packed into the front batch by the emulation thread and written
+// out from the back batch by a background thread, the two are swapped under
+// the lock so neither side ever waits on disk I/O of the other. When the
+// writer falls a whole batch behind frames are dropped, unless the capture is
+// lossless (headless runs) in which case the emulation waits for the swap.
+typedef struct
+{
+    CaptureFormat format;
+    const char *path;
+    FILE *file;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_cond_t drained;
+    CaptureFrame batches[2][CAPTURE_BATCH_FRAMES];
+    CaptureFrame *front;
+    CaptureFrame *back;
+    size_t front_count;
+    bool stopping;
+    bool lossless;
+
+    uint64_t frames_written;
+    uint64_t frames_dropped;
+    int error;
+} Capture;
+
+Capture *capture_open(const char *path, CaptureFormat format, bool lossless);
+void capture_frame(Capture *capture, const Display *display);
+int capture_close(Capture *capture);
+
+int capture_format_from_cstr(const char *name, CaptureFormat *format);
+const char *capture_format_to_cstr(CaptureFormat format);
@@ -0,0 +1,423 @@
+#include "Conformance.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Data/Font.h"
+#include "../Grid/WorkerPool.h"
+#include "../Options.h"
+#include "../Util/Clock.h"
+
+#define CONFORMANCE_LINE_LENGTH 1024
+#define CONFORMANCE_PATH_LENGTH 4096
+#define CONFORMANCE_FPS 60
+
+typedef struct
+{
+    char **lines;
+    size_t line_count;
+    ConformanceEntry *entries;
+    size_t entry_count;
+    unsigned int ips;
+} ConformanceSuite;
+
+static char *conformance_strdup(const char *text)
+{
+    size_t length = strlen(text) + 1;
+    char *copy = malloc(length);
+    if (copy != NULL)
+    {
+        memcpy(copy, text, length);
+    }
+    return copy;
+}
+
+static int conformance_parse_press(const char *value, ScriptedPress *press)
+{
+    unsigned long long frame, key, duration = CONFORMANCE_PRESS_FRAMES;
+    int count = sscanf(value, "%llu:%llx:%llu", &frame, &key, &duration);
+    if (count < 2 || key > 0xF || duration == 0)
+    {
+        return 1;
+    }
+
+    press->frame = frame;
+    press->key = (uint8_t)key;
+    press->duration = duration;
+    return 0;
+}
+
+static int conformance_parse_entry(const char *manifest, char *line, size_t line_number, ConformanceEntry *entry)
+{
+    memset(entry, 0, sizeof(ConformanceEntry));
+    entry->line = line_number;
+    entry->frames = CONFORMANCE_DEFAULT_FRAMES;
+    entry->seed = 1;
+
+    char *token = strtok(line, " \t\r\n");
+    entry->name = conformance_strdup(token);
+
+    // ROM paths are relative to the manifest
+    const char *separator = strrchr(manifest, '/');
+    size_t directory_length = separator != NULL && token[0] != '/' ? (size_t)(separator - manifest) + 1 : 0;
+    entry->path = malloc(directory_length + strlen(token) + 1);
+    if (entry->name == NULL || entry->path == NULL)
+    {
+        return 1;
+    }
+    memcpy(entry->path, manifest, directory_length);
+    strcpy(entry->path + directory_length, token);
+
+    while ((token = strtok(NULL, " \t\r\n")) != NULL)
+    {
+        char *value = strchr(token, '=');
+        if (value == NULL)
+        {
+            fprintf(stderr, "ERROR: %s:%zu: expected key=value, got %s\n", manifest, line_number + 1, token);
+            return 1;
+        }
+        *value++ = '\0';
+
+        int error = 0;
+        if (strcmp(token, "frames") == 0)
+        {
+            unsigned long long frames;
+            error = parse_number("frames", value, UINT64_MAX, &frames);
+            entry->frames = frames;
+        }
+        else if (strcmp(token, "hash") == 0)
+        {
+            char *end;
+            errno = 0;
+            entry->has_hash = true;
+            entry->expected_hash = strtoull(value, &end, 16);
+            error = !isxdigit((unsigned char)*value) || *end != '\0' || errno != 0;
+        }
+        else if (strcmp(token, "ips") == 0)
+        {
+            char *end;
+            entry->baseline_ips = strtod(value, &end);
+            error = *value == '\0' || *end != '\0' || !isfinite(entry->baseline_ips) || entry->baseline_ips < 0;
+        }
+        else if (strcmp(token, "seed") == 0)
+        {
+            char *end;
+            errno = 0;
+            unsigned long long seed = strtoull(value, &end, 10);
+            error = !isdigit((unsigned char)*value) || *end != '\0' || errno != 0 || seed > UINT32_MAX;
+            entry->seed = (uint32_t)seed;
+        }
+        else if (strcmp(token, "press") == 0 && entry->press_count < CONFORMANCE_MAX_PRESSES)
+        {
+            error = conformance_parse_press(value, &entry->presses[entry->press_count++]);
+        }
+        else
+        {
+            error = 1;
+        }
+
+        if (error)
+        {
+            fprintf(stderr, "ERROR: %s:%zu: invalid %s=%s\n", manifest, line_number + 1, token, value);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void conformance_free(ConformanceSuite *suite)
+{
+    for (size_t i = 0; i < suite->line_count; i++)
+    {
+        free(suite->lines[i]);
+    }
+    for (size_t i = 0; i < suite->entry_count; i++)
+    {
+        free(suite->entries[i].name);
+        free(suite->entries[i].path);
+    }
+    free(suite->lines);
+    free(suite->entries);
+}
+
+static int conformance_load(ConformanceSuite *suite, const char *manifest)
+{
+    FILE *file = fopen(manifest, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "ERROR: Unable to open manifest %s.\n", manifest);
+        return 1;
+    }
+
+    char line[CONFORMANCE_LINE_LENGTH];
+    size_t capacity = 0;
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        if (suite->line_count == capacity)
+        {
+            capacity = capacity > 0 ? capacity * 2 : 64;
+            char **lines = realloc(suite->lines, capacity * sizeof(char *));
+            ConformanceEntry *entries = realloc(suite->entries, capacity * sizeof(ConformanceEntry));
+            if (lines != NULL)
+            {
+                suite->lines = lines;
+            }
+            if (entries != NULL)
+            {
+                suite->entries = entries;
+            }
+            if (lines == NULL || entries == NULL)
+            {
+                fclose(file);
+                return 1;
+            }
+        }
+
+        line[strcspn(line, "\r\n")] = '\0';
+        suite->lines[suite->line_count] = conformance_strdup(line);
+        if (suite->lines[suite->line_count] == NULL)
+        {
+            fclose(file);
+            return 1;
+        }
+
+        const char *start = line + strspn(line, " \t");
+        if (*start != '\0' && *start != '#')
+        {
+            if (conformance_parse_entry(manifest, line, suite->line_count, &suite->entries[suite->entry_count]) != 0)
+            {
+                suite->entry_count++;
+                suite->line_count++;
+                fclose(file);
+                return 1;
+            }
+            suite->entry_count++;
+        }
+        suite->line_count++;
+    }
+
+    fclose(file);
+    return 0;
+}
+
+static VMError conformance_emulate(const VM *pristine, VM *vm, const ConformanceEntry *entry, unsigned int ips)
+{
+    memcpy(vm, pristine, sizeof(VM));
+
+    Keyboard keyboard = {0};
+    InputQueue input = {0};
+    double instruction_budget = 0;
+
+    for (uint64_t frame = 0; frame < entry->frames; frame++)
+    {
+        for (size_t i = 0; i < entry->press_count; i++)
+        {
+            const ScriptedPress *press = &entry->presses[i];
+            if (press->frame == frame || press->frame + press->duration == frame)
+            {
+                InputEvent event = {.cycle = vm->cycles, .key = press->key, .pressed = press->frame == frame};
+                input_queue_push(&input, event);
+            }
+        }
+
+        instruction_budget += (double)ips / CONFORMANCE_FPS;
+        unsigned int instructions = (unsigned int)instruction_budget;
+        instruction_budget -= instructions;
+
+        VMError error = vm_run_frame(vm, &keyboard, &input, instructions);
+        if (error != VMERROR_OK)
+        {
+            return error;
+        }
+    }
+
+    return VMERROR_OK;
+}
+
+static void conformance_job(void *context, size_t index)
+{
+    ConformanceSuite *suite = context;
+    ConformanceEntry *entry = &suite->entries[index];
+
+    VM *pristine = vm_new();
+    VM *vm = vm_new();
+    if (pristine == NULL || vm == NULL)
+    {
+        vm_free(pristine);
+        vm_free(vm);
+        return;
+    }
+
+    vm_seed_random(pristine, entry->seed);
+    vm_memcpy(pristine, 0x0, (void *)FONT_DATA, FONT_DATA_SIZE);
+    if (vm_load_program(pristine, entry->path) == 0)
+    {
+        pristine->program_counter = 0x200;
+        entry->loaded = true;
+
+        entry->error = conformance_emulate(pristine, vm, entry, suite->ips);
+        entry->hash = display_hash(&vm->display);
+
+        // Repeat the run until the timing is long enough to be meaningful.
+        // Thread CPU time keeps ROMs sharing a core from slowing each other down
+        uint64_t instructions = 0;
+        double start = clock_thread_ms();
+        double elapsed = 0;
+        while (entry->error == VMERROR_OK && elapsed < CONFORMANCE_BENCHMARK_MS)
+        {
+            conformance_emulate(pristine, vm, entry, suite->ips);
+            instructions += vm->cycles;
+            elapsed = clock_thread_ms() - start;
+        }
+        entry->ips = elapsed > 0 ? (double)instructions * 1000.0 / elapsed : 0;
+    }
+
+    vm_free(pristine);
+    vm_free(vm);
+}
+
+static int conformance_write(const ConformanceSuite *suite, const char *manifest)
+{
+    char temporary_path[CONFORMANCE_PATH_LENGTH];
+    if (snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", manifest) >= (int)sizeof(temporary_path))
+    {
+        fprintf(stderr, "ERROR: Manifest path %s is too long.\n", manifest);
+        return 1;
+    }
+
+    // Written next to the manifest and renamed over it, so a failed write never truncates it
+    FILE *file = fopen(temporary_path, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "ERROR: Unable to write manifest %s.\n", temporary_path);
+        return 1;
+    }
+
+    size_t next_entry = 0;
+    for (size_t i = 0; i < suite->line_count; i++)
+    {
+        if (next_entry >= suite->entry_count || suite->entries[next_entry].line != i)
+        {
+            fprintf(file, "%s\n", suite->lines[i]);
+            continue;
+        }
+
+        // Entries that did not run keep their previous golden values
+        const ConformanceEntry *entry = &suite->entries[next_entry++];
+        if (!entry->loaded || entry->error != VMERROR_OK)
+        {
+            fprintf(file, "%s\n", suite->lines[i]);
+            continue;
+        }
+
+        fprintf(file, "%s frames=%" PRIu64 " hash=%016" PRIx64 " ips=%.0f", entry->name, entry->frames, entry->hash, entry->ips);
+        if (entry->seed != 1)
+        {
+            fprintf(file, " seed=%" PRIu32, entry->seed);
+        }
+        for (size_t p = 0; p < entry->press_count; p++)
+        {
+            const ScriptedPress *press = &entry->presses[p];
+            fprintf(file, " press=%" PRIu64 ":%X:%" PRIu64, press->frame, press->key, press->duration);
+        }
+        fprintf(file, "\n");
+    }
+
+    bool written = !ferror(file);
+    if (fclose(file) != 0 || !written || rename(temporary_path, manifest) != 0)
+    {
+        fprintf(stderr, "ERROR: Unable to write manifest %s.\n", manifest);
+        remove(temporary_path);
+        return 1;
+    }
+
+    return 0;
+}
+
+// Runs every ROM of the manifest headlessly in parallel, checks the final
+// display against its golden hash and the interpreter speed against its baseline
+int conformance_run(const char *manifest, unsigned int ips, size_t threads, double tolerance, bool update)
+{
+    ConformanceSuite suite = {0};
+    suite.ips = ips;
+
+    if (conformance_load(&suite, manifest) != 0)
+    {
+        conformance_free(&suite);
+        return 1;
+    }
+
+    WorkerPool *pool = worker_pool_new(threads);
+    if (pool == NULL)
+    {
+        conformance_free(&suite);
+        return 1;
+    }
+
+    double start = clock_now_ms();
+    worker_pool_run(pool, conformance_job, &suite, suite.entry_count);
+    double elapsed = clock_now_ms() - start;
+    worker_pool_free(pool);
+
+    size_t failures = 0;
+    for (size_t i = 0; i < suite.entry_count; i++)
+    {
+        const ConformanceEntry *entry = &suite.entries[i];
+
+        if (!entry->loaded)
+        {
+            printf("FAIL  %s  could not be loaded\n", entry->name);
+            failures++;
+            continue;
+        }
+
+        if (entry->error != VMERROR_OK)
+        {
+            printf("FAIL  %s  %s\n", entry->name, vmerror_to_cstr(entry->error));
+            failures++;
+            continue;
+        }
+
+        bool hash_ok = update || !entry->has_hash || entry->hash == entry->expected_hash;
+        bool speed_ok = update || entry->baseline_ips <= 0 || entry->ips >= entry->baseline_ips * (1.0 - tolerance / 100.0);
+        const char *status = !hash_ok ? "FAIL" : !speed_ok ? "SLOW" : "PASS";
+
+        printf("%s  %s  hash %016" PRIx64, status, entry->name, entry->hash);
+        if (!hash_ok)
+        {
+            printf(" (expected %016" PRIx64 ")", entry->expected_hash);
+        }
+        printf("  %.1fM IPS", entry->ips / 1000000.0);
+        if (entry->baseline_ips > 0)
+        {
+            printf(" (baseline %.1fM, %+.1f%%)", entry->baseline_ips / 1000000.0, (entry->ips / entry->baseline_ips - 1.0) * 100.0);
+        }
+        printf("\n");
+
+        if (!hash_ok || !speed_ok)
+        {
+            failures++;
+        }
+    }
+
+    printf("%zu of %zu ROMs passed in %.0fms on %zu threads\n", suite.entry_count - failures, suite.entry_count, elapsed, threads);
+
+    int status = failures > 0;
+    if (update && conformance_write(&suite, manifest) != 0)
+    {
+        status = 1;
+    }
+    else if (update)
+    {
+        printf("Updated golden hashes and baselines in %s\n", manifest);
+    }
+
+    conformance_free(&suite);
+    return status;
+}
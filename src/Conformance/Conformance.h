@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../VM/VM.h"
+
+#define CONFORMANCE_DEFAULT_FRAMES 600
+#define CONFORMANCE_MAX_PRESSES 16
+#define CONFORMANCE_PRESS_FRAMES 5
+#define CONFORMANCE_BENCHMARK_MS 50.0
+
+typedef struct
+{
+    uint64_t frame;
+    uint64_t duration;
+    uint8_t key;
+} ScriptedPress;
+
+// One manifest line:
+//
+//   path/to/rom.ch8 frames=600 hash=0123456789abcdef ips=250000000 seed=1 press=120:5:10
+//
+// Paths are relative to the manifest. hash is the display_hash of the final
+// frame, ips the baseline speed of the unthrottled interpreter, press holds
+// KEY down at FRAME for FRAMES frames (5 if omitted). Lines starting with #
+// are comments.
+typedef struct
+{
+    size_t line;
+    char *name;
+    char *path;
+    uint64_t frames;
+    uint32_t seed;
+    bool has_hash;
+    uint64_t expected_hash;
+    double baseline_ips;
+    ScriptedPress presses[CONFORMANCE_MAX_PRESSES];
+    size_t press_count;
+
+    bool loaded;
+    VMError error;
+    uint64_t hash;
+    double ips;
+} ConformanceEntry;
+
+int conformance_run(const char *manifest, unsigned int ips, size_t threads, double tolerance, bool update);
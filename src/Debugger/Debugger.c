@@ -0,0 +1,245 @@
+#include "Debugger.h"
+
+#include <stdio.h>
+
+#include "../VM/Instructions.h"
+
+int debugger_add_breakpoint(Debugger *debugger, Breakpoint breakpoint)
+{
+    if (debugger->breakpoint_count >= DEBUGGER_MAX_BREAKPOINTS)
+    {
+        return 1;
+    }
+
+    debugger->breakpoints[debugger->breakpoint_count++] = breakpoint;
+    return 0;
+}
+
+int debugger_remove_breakpoint(Debugger *debugger, size_t index)
+{
+    if (index >= debugger->breakpoint_count)
+    {
+        return 1;
+    }
+
+    for (size_t i = index; i + 1 < debugger->breakpoint_count; i++)
+    {
+        debugger->breakpoints[i] = debugger->breakpoints[i + 1];
+    }
+    debugger->breakpoint_count--;
+    return 0;
+}
+
+int debugger_add_watchpoint(Debugger *debugger, Watchpoint watchpoint)
+{
+    if (debugger->watchpoint_count >= DEBUGGER_MAX_WATCHPOINTS || watchpoint.end < watchpoint.start)
+    {
+        return 1;
+    }
+
+    debugger->watchpoints[debugger->watchpoint_count++] = watchpoint;
+    return 0;
+}
+
+int debugger_remove_watchpoint(Debugger *debugger, size_t index)
+{
+    if (index >= debugger->watchpoint_count)
+    {
+        return 1;
+    }
+
+    for (size_t i = index; i + 1 < debugger->watchpoint_count; i++)
+    {
+        debugger->watchpoints[i] = debugger->watchpoints[i + 1];
+    }
+    debugger->watchpoint_count--;
+    return 0;
+}
+
+void debugger_continue(Debugger *debugger)
+{
+    debugger->paused = false;
+    debugger->stepping = false;
+    debugger->resuming = true;
+}
+
+void debugger_step(Debugger *debugger)
+{
+    debugger->paused = false;
+    debugger->stepping = true;
+    debugger->resuming = true;
+}
+
+void debugger_step_over(Debugger *debugger, const VM *vm)
+{
+    INST instruction = vm_fetch(vm);
+    if ((instruction & 0xF000) != INST_SCALL)
+    {
+        debugger_step(debugger);
+        return;
+    }
+
+    Breakpoint breakpoint = {
+        .address = (uint16_t)((vm->program_counter + 2) & VM_ADDRESS_MASK),
+        .temporary = true,
+        .stack_depth = vm->stack.top,
+    };
+
+    if (debugger_add_breakpoint(debugger, breakpoint) != 0)
+    {
+        debugger_step(debugger);
+        return;
+    }
+    debugger_continue(debugger);
+}
+
+static bool debugger_condition_holds(const Breakpoint *breakpoint, const VM *vm)
+{
+    uint8_t value = vm->variable_registers[breakpoint->condition_register & 0x0F];
+    switch (breakpoint->condition)
+    {
+    case CONDITION_NONE:
+        return true;
+    case CONDITION_EQUAL:
+        return value == breakpoint->condition_value;
+    case CONDITION_NOT_EQUAL:
+        return value != breakpoint->condition_value;
+    case CONDITION_LESS:
+        return value < breakpoint->condition_value;
+    case CONDITION_GREATER:
+        return value > breakpoint->condition_value;
+    default:
+        return false;
+    }
+}
+
+static bool debugger_check_breakpoints(Debugger *debugger, const VM *vm)
+{
+    for (size_t i = 0; i < debugger->breakpoint_count; i++)
+    {
+        Breakpoint *breakpoint = &debugger->breakpoints[i];
+        if (!breakpoint->any_address && breakpoint->address != vm->program_counter)
+        {
+            continue;
+        }
+
+        if (breakpoint->temporary)
+        {
+            // Recursive calls pass the return address with a deeper stack
+            if (vm->stack.top > breakpoint->stack_depth)
+            {
+                continue;
+            }
+            debugger_remove_breakpoint(debugger, i);
+            snprintf(debugger->reason, sizeof(debugger->reason), "step over");
+            return true;
+        }
+
+        bool holds = debugger_condition_holds(breakpoint, vm);
+        if (breakpoint->any_address)
+        {
+            bool triggered = breakpoint->triggered;
+            breakpoint->triggered = holds;
+            holds = holds && !triggered;
+        }
+
+        if (holds)
+        {
+            snprintf(debugger->reason, sizeof(debugger->reason), "breakpoint %zu", i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// FX33 and FX55 are the only instructions writing to memory. Like the VM the
+// written range wraps around at the end of memory
+static bool debugger_check_watchpoints(Debugger *debugger, const VM *vm, INST instruction)
+{
+    size_t count;
+    uint8_t X = (instruction & 0x0F00) >> 8;
+    switch (instruction & 0xF0FF)
+    {
+    case 0xF033:
+        count = 3;
+        break;
+    case 0xF055:
+        count = (size_t)X + 1;
+        break;
+    default:
+        return false;
+    }
+
+    size_t start = vm->index_register & VM_ADDRESS_MASK;
+    size_t end = (start + count - 1) & VM_ADDRESS_MASK;
+    for (size_t i = 0; i < debugger->watchpoint_count; i++)
+    {
+        const Watchpoint *watchpoint = &debugger->watchpoints[i];
+        for (size_t offset = 0; offset < count; offset++)
+        {
+            size_t address = (start + offset) & VM_ADDRESS_MASK;
+            if (address >= watchpoint->start && address <= watchpoint->end)
+            {
+                snprintf(debugger->reason, sizeof(debugger->reason), "watchpoint %zu (write 0x%03zX-0x%03zX)", i, start, end);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+static VMError debugger_step_frame(Debugger *debugger, VM *vm, Keyboard *keyboard, InputQueue *input, unsigned int instructions)
+{
+    if (debugger->paused)
+    {
+        return VMERROR_OK;
+    }
+
+    for (unsigned int i = 0; i < instructions; i++)
+    {
+        // The instruction we stopped on must be able to run once we resume
+        if (!debugger->resuming && debugger_check_breakpoints(debugger, vm))
+        {
+            debugger->paused = true;
+            return VMERROR_OK;
+        }
+        debugger->resuming = false;
+
+        INST instruction = vm_fetch(vm);
+        bool watched = debugger->watchpoint_count > 0 && debugger_check_watchpoints(debugger, vm, instruction);
+
+        input_queue_apply(input, keyboard, vm->cycles);
+        VMError error = vm_execute(vm, keyboard);
+        if (error != VMERROR_OK)
+        {
+            snprintf(debugger->reason, sizeof(debugger->reason), "%s", vmerror_to_cstr(error));
+            debugger->paused = true;
+            return error;
+        }
+
+        if (watched)
+        {
+            debugger->paused = true;
+            return VMERROR_OK;
+        }
+
+        if (debugger->stepping)
+        {
+            snprintf(debugger->reason, sizeof(debugger->reason), "step");
+            debugger->paused = true;
+            return VMERROR_OK;
+        }
+    }
+
+    vm_tick_timers(vm);
+    return VMERROR_OK;
+}
+
+VMError debugger_run_frame(Debugger *debugger, VM *vm, Keyboard *keyboard, InputQueue *input, unsigned int instructions)
+{
+    VMError error = debugger_step_frame(debugger, vm, keyboard, input, instructions);
+    display_commit(&vm->display);
+    return error;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../VM/VM.h"
+
+#define DEBUGGER_MAX_BREAKPOINTS 32
+#define DEBUGGER_MAX_WATCHPOINTS 16
+
+typedef enum ConditionOperator
+{
+    CONDITION_NONE = 0,
+    CONDITION_EQUAL,
+    CONDITION_NOT_EQUAL,
+    CONDITION_LESS,
+    CONDITION_GREATER
+} ConditionOperator;
+
+typedef struct
+{
+    bool any_address;
+    uint16_t address;
+    ConditionOperator condition;
+    uint8_t condition_register;
+    uint8_t condition_value;
+    // Breakpoints without an address fire when their condition becomes true
+    bool triggered;
+    // Step over plants a temporary breakpoint that only fires once the call returned
+    bool temporary;
+    int stack_depth;
+} Breakpoint;
+
+typedef struct
+{
+    uint16_t start;
+    uint16_t end;
+} Watchpoint;
+
+// Breakpoint checks live in debugger_run_frame, a separate interpreter loop
+// the frontend picks once per frame, so vm_run_frame stays untouched.
+typedef struct
+{
+    Breakpoint breakpoints[DEBUGGER_MAX_BREAKPOINTS];
+    size_t breakpoint_count;
+    Watchpoint watchpoints[DEBUGGER_MAX_WATCHPOINTS];
+    size_t watchpoint_count;
+
+    bool paused;
+    bool stepping;
+    bool resuming;
+    char reason[64];
+} Debugger;
+
+int debugger_add_breakpoint(Debugger *debugger, Breakpoint breakpoint);
+int debugger_remove_breakpoint(Debugger *debugger, size_t index);
+int debugger_add_watchpoint(Debugger *debugger, Watchpoint watchpoint);
+int debugger_remove_watchpoint(Debugger *debugger, size_t index);
+
+void debugger_continue(Debugger *debugger);
+void debugger_step(Debugger *debugger);
+void debugger_step_over(Debugger *debugger, const VM *vm);
+
+VMError debugger_run_frame(Debugger *debugger, VM *vm, Keyboard *keyboard, InputQueue *input, unsigned int instructions);
+
+int debugger_prompt(Debugger *debugger, VM *vm);
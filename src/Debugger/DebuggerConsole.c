@@ -0,0 +1,318 @@
+#include "Debugger.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../VM/Instructions.h"
+
+#define DEBUGGER_LINE_LENGTH 128
+
+static void debugger_print_help(void)
+{
+    printf("  c                    continue\n");
+    printf("  s                    step one instruction\n");
+    printf("  n                    step, running over 2NNN calls\n");
+    printf("  b ADDR [VX OP NN]    break at ADDR, optionally only when the condition holds (OP: == != < >)\n");
+    printf("  b * VX OP NN         break anywhere once the condition becomes true\n");
+    printf("  w START [END]        break after FX33/FX55 write into START..END\n");
+    printf("  d N / dw N           delete breakpoint / watchpoint N\n");
+    printf("  l                    list breakpoints and watchpoints\n");
+    printf("  r                    show registers\n");
+    printf("  x ADDR [LENGTH]      dump memory\n");
+    printf("  u [ADDR] [COUNT]     disassemble\n");
+    printf("  q                    quit\n");
+}
+
+static void debugger_print_registers(const VM *vm)
+{
+    printf("PC %03zX  I %03X  SP %2i  DT %02X  ST %02X  cycles %llu\n",
+           vm->program_counter,
+           vm->index_register,
+           vm->stack.top,
+           vm->delay_timer,
+           vm->sound_timer,
+           (unsigned long long)vm->cycles);
+
+    for (int i = 0; i < VM_VARIABLE_REGISTER_COUNT; i++)
+    {
+        printf("V%X %02X%s", i, vm->variable_registers[i], i % 8 == 7 ? "\n" : "  ");
+    }
+}
+
+static void debugger_disassemble(const VM *vm, size_t address, int count)
+{
+    for (int i = 0; i < count && address + 1 < VM_MEMORY_SIZE; i++, address += 2)
+    {
+        INST instruction = (INST)(vm->memory[address] << 8 | vm->memory[address + 1]);
+        char text[32];
+        instruction_disassemble(instruction, text, sizeof(text));
+        printf("%s %03zX  %04X  %s\n", address == vm->program_counter ? ">" : " ", address, instruction, text);
+    }
+}
+
+static void debugger_dump(const VM *vm, size_t address, size_t length)
+{
+    for (size_t offset = 0; offset < length && address + offset < VM_MEMORY_SIZE; offset++)
+    {
+        if (offset % 16 == 0)
+        {
+            printf("%s%03zX ", offset > 0 ? "\n" : "", address + offset);
+        }
+        printf(" %02X", vm->memory[address + offset]);
+    }
+    printf("\n");
+}
+
+static const char *condition_to_cstr(ConditionOperator condition)
+{
+    switch (condition)
+    {
+    case CONDITION_EQUAL:
+        return "==";
+    case CONDITION_NOT_EQUAL:
+        return "!=";
+    case CONDITION_LESS:
+        return "<";
+    case CONDITION_GREATER:
+        return ">";
+    case CONDITION_NONE:
+    default:
+        return "";
+    }
+}
+
+static void debugger_list(const Debugger *debugger)
+{
+    for (size_t i = 0; i < debugger->breakpoint_count; i++)
+    {
+        const Breakpoint *breakpoint = &debugger->breakpoints[i];
+        if (breakpoint->any_address)
+        {
+            printf("breakpoint %zu: *", i);
+        }
+        else
+        {
+            printf("breakpoint %zu: %03X", i, breakpoint->address);
+        }
+
+        if (breakpoint->condition != CONDITION_NONE)
+        {
+            printf(" V%X %s 0x%02X", breakpoint->condition_register, condition_to_cstr(breakpoint->condition), breakpoint->condition_value);
+        }
+        printf("%s\n", breakpoint->temporary ? " (step over)" : "");
+    }
+
+    for (size_t i = 0; i < debugger->watchpoint_count; i++)
+    {
+        printf("watchpoint %zu: %03X-%03X\n", i, debugger->watchpoints[i].start, debugger->watchpoints[i].end);
+    }
+}
+
+// Parses "VX OP NN", with or without spaces around the operator
+static int debugger_parse_condition(const char *text, Breakpoint *breakpoint)
+{
+    while (isspace((unsigned char)*text))
+    {
+        text++;
+    }
+
+    if (toupper((unsigned char)text[0]) != 'V' || !isxdigit((unsigned char)text[1]))
+    {
+        return 1;
+    }
+    breakpoint->condition_register = (uint8_t)strtoul((char[]){text[1], '\0'}, NULL, 16);
+    text += 2;
+
+    while (isspace((unsigned char)*text))
+    {
+        text++;
+    }
+
+    if (strncmp(text, "==", 2) == 0)
+    {
+        breakpoint->condition = CONDITION_EQUAL;
+        text += 2;
+    }
+    else if (strncmp(text, "!=", 2) == 0)
+    {
+        breakpoint->condition = CONDITION_NOT_EQUAL;
+        text += 2;
+    }
+    else if (*text == '<')
+    {
+        breakpoint->condition = CONDITION_LESS;
+        text++;
+    }
+    else if (*text == '>')
+    {
+        breakpoint->condition = CONDITION_GREATER;
+        text++;
+    }
+    else
+    {
+        return 1;
+    }
+
+    char *end = NULL;
+    unsigned long value = strtoul(text, &end, 0);
+    if (end == text || value > 0xFF)
+    {
+        return 1;
+    }
+    breakpoint->condition_value = (uint8_t)value;
+    return 0;
+}
+
+static int debugger_parse_breakpoint(const char *arguments, Breakpoint *breakpoint)
+{
+    while (isspace((unsigned char)*arguments))
+    {
+        arguments++;
+    }
+
+    const char *rest = NULL;
+    if (*arguments == '*')
+    {
+        breakpoint->any_address = true;
+        rest = arguments + 1;
+    }
+    else
+    {
+        char *end = NULL;
+        unsigned long address = strtoul(arguments, &end, 16);
+        if (end == arguments || address >= VM_MEMORY_SIZE)
+        {
+            return 1;
+        }
+        breakpoint->address = (uint16_t)address;
+        rest = end;
+    }
+
+    while (isspace((unsigned char)*rest))
+    {
+        rest++;
+    }
+
+    if (*rest == '\0')
+    {
+        return breakpoint->any_address;
+    }
+
+    return debugger_parse_condition(rest, breakpoint);
+}
+
+// Blocks on stdin until the user resumes execution, returns non zero to quit
+int debugger_prompt(Debugger *debugger, VM *vm)
+{
+    printf("Stopped: %s\n", debugger->reason[0] != '\0' ? debugger->reason : "break");
+    debugger_disassemble(vm, vm->program_counter, 1);
+
+    char line[DEBUGGER_LINE_LENGTH];
+    for (;;)
+    {
+        printf("(chip8) ");
+        fflush(stdout);
+
+        if (fgets(line, sizeof(line), stdin) == NULL)
+        {
+            return 1;
+        }
+
+        char command[8] = {0};
+        int consumed = 0;
+        if (sscanf(line, "%7s%n", command, &consumed) != 1)
+        {
+            continue;
+        }
+        const char *arguments = line + consumed;
+
+        if (strcmp(command, "c") == 0)
+        {
+            debugger_continue(debugger);
+            return 0;
+        }
+        else if (strcmp(command, "s") == 0)
+        {
+            debugger_step(debugger);
+            return 0;
+        }
+        else if (strcmp(command, "n") == 0)
+        {
+            debugger_step_over(debugger, vm);
+            return 0;
+        }
+        else if (strcmp(command, "q") == 0)
+        {
+            return 1;
+        }
+        else if (strcmp(command, "b") == 0)
+        {
+            Breakpoint breakpoint = {0};
+            if (debugger_parse_breakpoint(arguments, &breakpoint) != 0)
+            {
+                printf("Usage: b ADDR [VX OP NN] or b * VX OP NN\n");
+            }
+            else if (debugger_add_breakpoint(debugger, breakpoint) != 0)
+            {
+                printf("Too many breakpoints\n");
+            }
+        }
+        else if (strcmp(command, "w") == 0)
+        {
+            unsigned int start, end;
+            int count = sscanf(arguments, "%x %x", &start, &end);
+            if (count < 1 || start >= VM_MEMORY_SIZE)
+            {
+                printf("Usage: w START [END]\n");
+                continue;
+            }
+
+            Watchpoint watchpoint = {(uint16_t)start, (uint16_t)(count > 1 ? end : start)};
+            if (debugger_add_watchpoint(debugger, watchpoint) != 0)
+            {
+                printf("Invalid or too many watchpoints\n");
+            }
+        }
+        else if (strcmp(command, "d") == 0 || strcmp(command, "dw") == 0)
+        {
+            size_t index;
+            int removed = sscanf(arguments, "%zu", &index) == 1 &&
+                          (command[1] == 'w' ? debugger_remove_watchpoint(debugger, index) : debugger_remove_breakpoint(debugger, index)) == 0;
+            if (!removed)
+            {
+                printf("No such %s\n", command[1] == 'w' ? "watchpoint" : "breakpoint");
+            }
+        }
+        else if (strcmp(command, "l") == 0)
+        {
+            debugger_list(debugger);
+        }
+        else if (strcmp(command, "r") == 0)
+        {
+            debugger_print_registers(vm);
+        }
+        else if (strcmp(command, "x") == 0)
+        {
+            unsigned int address, length = 16;
+            if (sscanf(arguments, "%x %u", &address, &length) < 1)
+            {
+                printf("Usage: x ADDR [LENGTH]\n");
+                continue;
+            }
+            debugger_dump(vm, address, length);
+        }
+        else if (strcmp(command, "u") == 0)
+        {
+            unsigned int address = (unsigned int)vm->program_counter;
+            int count = 10;
+            sscanf(arguments, "%x %i", &address, &count);
+            debugger_disassemble(vm, address, count);
+        }
+        else
+        {
+            debugger_print_help();
+        }
+    }
+}
@@ -0,0 +1,202 @@
+#include "Grid.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../Data/Font.h"
+#include "../Rendering/Filters.h"
+#include "../Util/Clock.h"
+
+#define GRID_COLOR_BACKGROUND 0xFF000000
+#define GRID_COLOR_ON 0xFFFFFFFF
+#define GRID_COLOR_OFF 0xFF0A0A0A
+#define GRID_COLOR_IPS 0xFF40E040
+#define GRID_COLOR_FRAME_TIME 0xFFE0A040
+#define GRID_COLOR_ERROR 0xFFE04040
+
+#define GRID_GLYPH_WIDTH 4
+#define GRID_GLYPH_HEIGHT 5
+#define GRID_GLYPH_ADVANCE 5
+
+Grid *grid_new(const char *const *rom_paths, size_t count, size_t threads)
+{
+    Grid *grid = calloc(1, sizeof(Grid));
+    if (grid == NULL)
+    {
+        return NULL;
+    }
+
+    grid->instances = calloc(count, sizeof(GridInstance));
+    if (grid->instances == NULL)
+    {
+        grid_free(grid);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        GridInstance *instance = &grid->instances[i];
+        instance->rom_path = rom_paths[i];
+        instance->vm = vm_new();
+        grid->count++;
+        if (instance->vm == NULL)
+        {
+            grid_free(grid);
+            return NULL;
+        }
+
+        vm_seed_random(instance->vm, (uint32_t)time(NULL) + (uint32_t)i);
+        vm_memcpy(instance->vm, 0x0, (void *)FONT_DATA, FONT_DATA_SIZE);
+        if (vm_load_program(instance->vm, rom_paths[i]) != 0)
+        {
+            grid_free(grid);
+            return NULL;
+        }
+        instance->vm->program_counter = 0x200;
+    }
+
+    grid->columns = (int)ceil(sqrt((double)count));
+    grid->rows = (int)((count + (size_t)grid->columns - 1) / (size_t)grid->columns);
+    grid->width = grid->columns * GRID_TILE_WIDTH;
+    grid->height = grid->rows * GRID_TILE_HEIGHT;
+
+    grid->pixels = malloc((size_t)grid->width * (size_t)grid->height * sizeof(uint32_t));
+    grid->pool = worker_pool_new(threads);
+    if (grid->pixels == NULL || grid->pool == NULL)
+    {
+        grid_free(grid);
+        return NULL;
+    }
+
+    for (int i = 0; i < grid->width * grid->height; i++)
+    {
+        grid->pixels[i] = GRID_COLOR_BACKGROUND;
+    }
+
+    return grid;
+}
+
+void grid_free(Grid *grid)
+{
+    if (grid == NULL)
+    {
+        return;
+    }
+
+    worker_pool_free(grid->pool);
+    for (size_t i = 0; i < grid->count; i++)
+    {
+        vm_free(grid->instances[i].vm);
+    }
+    free(grid->instances);
+    free(grid->pixels);
+    free(grid);
+}
+
+void grid_push_key(Grid *grid, uint8_t key, bool pressed, uint64_t cycle_offset)
+{
+    for (size_t i = 0; i < grid->count; i++)
+    {
+        GridInstance *instance = &grid->instances[i];
+        InputEvent event = {
+            .cycle = instance->vm->cycles + cycle_offset,
+            .key = key,
+            .pressed = pressed,
+        };
+        input_queue_push(&instance->input, event);
+    }
+}
+
+static void grid_draw_number(uint32_t *pixels, int stride, int x, int y, uint64_t value, bool right_align, uint32_t color)
+{
+    char digits[21];
+    int length = snprintf(digits, sizeof(digits), "%llu", (unsigned long long)value);
+    if (right_align)
+    {
+        x -= length * GRID_GLYPH_ADVANCE - 1;
+    }
+
+    for (int i = 0; i < length; i++)
+    {
+        const uint8_t *glyph = &FONT_DATA[(digits[i] - '0') * GRID_GLYPH_HEIGHT];
+        for (int row = 0; row < GRID_GLYPH_HEIGHT; row++)
+        {
+            for (int column = 0; column < GRID_GLYPH_WIDTH; column++)
+            {
+                if (glyph[row] & (0x80 >> column))
+                {
+                    pixels[(y + row) * stride + x + i * GRID_GLYPH_ADVANCE + column] = color;
+                }
+            }
+        }
+    }
+}
+
+static void grid_draw_tile(Grid *grid, size_t index)
+{
+    GridInstance *instance = &grid->instances[index];
+    int tile_x = (int)(index % (size_t)grid->columns) * GRID_TILE_WIDTH;
+    int tile_y = (int)(index / (size_t)grid->columns) * GRID_TILE_HEIGHT;
+    uint32_t *tile = &grid->pixels[tile_y * grid->width + tile_x];
+
+    uint64_t rows[VM_DISPLAY_HEIGHT];
+    display_pack_rows(&instance->vm->display, rows);
+    for (int y = 0; y < VM_DISPLAY_HEIGHT; y++)
+    {
+        filter_expand_bits(&rows[y], VM_DISPLAY_WIDTH, &tile[y * grid->width], GRID_COLOR_ON, GRID_COLOR_OFF);
+    }
+
+    uint32_t *overlay = &tile[VM_DISPLAY_HEIGHT * grid->width];
+    for (int y = 0; y < GRID_OVERLAY_HEIGHT; y++)
+    {
+        for (int x = 0; x < VM_DISPLAY_WIDTH; x++)
+        {
+            overlay[y * grid->width + x] = GRID_COLOR_BACKGROUND;
+        }
+    }
+
+    // IPS on the left, frame time in microseconds on the right
+    bool failed = instance->error != VMERROR_OK;
+    grid_draw_number(overlay, grid->width, 1, 1, instance->ips, false, failed ? GRID_COLOR_ERROR : GRID_COLOR_IPS);
+    grid_draw_number(overlay, grid->width, VM_DISPLAY_WIDTH - 2, 1, (uint64_t)(instance->frame_ms * 1000.0), true, GRID_COLOR_FRAME_TIME);
+}
+
+static void grid_instance_frame(void *context, size_t index)
+{
+    Grid *grid = context;
+    GridInstance *instance = &grid->instances[index];
+
+    double start = clock_now_ms();
+
+    // A VM that hit an error stays frozen on its last frame
+    if (instance->error == VMERROR_OK)
+    {
+        uint64_t cycles = instance->vm->cycles;
+        instance->error = vm_run_frame(instance->vm, &instance->keyboard, &instance->input, grid->instructions);
+        instance->second_instructions += instance->vm->cycles - cycles;
+        if (instance->error != VMERROR_OK)
+        {
+            fprintf(stderr, "ERROR: %s: %s\n", instance->rom_path, vmerror_to_cstr(instance->error));
+        }
+    }
+
+    grid_draw_tile(grid, index);
+    instance->frame_ms = clock_now_ms() - start;
+}
+
+void grid_run_frame(Grid *grid, unsigned int instructions)
+{
+    grid->instructions = instructions;
+    worker_pool_run(grid->pool, grid_instance_frame, grid, grid->count);
+}
+
+void grid_end_second(Grid *grid)
+{
+    for (size_t i = 0; i < grid->count; i++)
+    {
+        grid->instances[i].ips = grid->instances[i].second_instructions;
+        grid->instances[i].second_instructions = 0;
+    }
+}
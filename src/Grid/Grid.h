@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../VM/VM.h"
+#include "WorkerPool.h"
+
+#define GRID_TILE_GAP 2
+#define GRID_OVERLAY_HEIGHT 7
+#define GRID_TILE_WIDTH (VM_DISPLAY_WIDTH + GRID_TILE_GAP)
+#define GRID_TILE_HEIGHT (VM_DISPLAY_HEIGHT + GRID_OVERLAY_HEIGHT + GRID_TILE_GAP)
+
+typedef struct
+{
+    VM *vm;
+    Keyboard keyboard;
+    InputQueue input;
+    const char *rom_path;
+    VMError error;
+    double frame_ms;
+    uint64_t second_instructions;
+    uint64_t ips;
+} GridInstance;
+
+// Many VMs stepped together on a worker pool. Every frame each worker also
+// draws its instances into their tile of one shared ARGB atlas, with the
+// instance's IPS and frame time in the strip below its display.
+typedef struct
+{
+    GridInstance *instances;
+    size_t count;
+    int columns;
+    int rows;
+    int width;
+    int height;
+    uint32_t *pixels;
+    unsigned int instructions;
+    WorkerPool *pool;
+} Grid;
+
+Grid *grid_new(const char *const *rom_paths, size_t count, size_t threads);
+void grid_free(Grid *grid);
+void grid_push_key(Grid *grid, uint8_t key, bool pressed, uint64_t cycle_offset);
+void grid_run_frame(Grid *grid, unsigned int instructions);
+void grid_end_second(Grid *grid);
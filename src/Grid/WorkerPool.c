@@ -0,0 +1,130 @@
+#include "WorkerPool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static void worker_pool_work(WorkerPool *pool)
+{
+    for (;;)
+    {
+        size_t index = atomic_fetch_add_explicit(&pool->next, 1, memory_order_relaxed);
+        if (index >= pool->count)
+        {
+            return;
+        }
+        pool->job(pool->context, index);
+    }
+}
+
+static void *worker_pool_thread(void *argument)
+{
+    WorkerPool *pool = argument;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;)
+    {
+        while (pool->generation == seen && !pool->stopping)
+        {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+
+        if (pool->stopping)
+        {
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        worker_pool_work(pool);
+
+        pthread_mutex_lock(&pool->lock);
+        if (++pool->finished == pool->thread_count)
+        {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+WorkerPool *worker_pool_new(size_t threads)
+{
+    WorkerPool *pool = calloc(1, sizeof(WorkerPool));
+    if (pool == NULL)
+    {
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    size_t background = threads > 1 ? threads - 1 : 0;
+    pool->threads = calloc(background > 0 ? background : 1, sizeof(pthread_t));
+    if (pool->threads == NULL)
+    {
+        worker_pool_free(pool);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < background; i++)
+    {
+        if (pthread_create(&pool->threads[i], NULL, worker_pool_thread, pool) != 0)
+        {
+            fprintf(stderr, "ERROR: Failed to start worker thread.\n");
+            worker_pool_free(pool);
+            return NULL;
+        }
+        pool->thread_count++;
+    }
+
+    return pool;
+}
+
+void worker_pool_run(WorkerPool *pool, WorkerJob job, void *context, size_t count)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->job = job;
+    pool->context = context;
+    pool->count = count;
+    atomic_store_explicit(&pool->next, 0, memory_order_relaxed);
+    pool->finished = 0;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    worker_pool_work(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->finished < pool->thread_count)
+    {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void worker_pool_free(WorkerPool *pool)
+{
+    if (pool == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 0; i < pool->thread_count; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool);
+}
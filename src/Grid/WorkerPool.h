@@ -0,0 +1,32 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef void (*WorkerJob)(void *context, size_t index);
+
+// Fixed set of threads that run a job over indices [0, count). The calling
+// thread takes part in the work, so a pool of one thread spawns nothing.
+typedef struct
+{
+    pthread_t *threads;
+    size_t thread_count;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    uint64_t generation;
+    size_t finished;
+    bool stopping;
+
+    WorkerJob job;
+    void *context;
+    size_t count;
+    _Atomic size_t next;
+} WorkerPool;
+
+WorkerPool *worker_pool_new(size_t threads);
+void worker_pool_run(WorkerPool *pool, WorkerJob job, void *context, size_t count);
+void worker_pool_free(WorkerPool *pool);
@@ -0,0 +1,94 @@
+#include "Headless.h"
+
+#include <signal.h>
+
+#include "Options.h"
+#include "Util/Clock.h"
+
+static volatile sig_atomic_t headless_stop_requested = 0;
+
+static void headless_request_stop(int signal_number)
+{
+    (void)signal_number;
+    headless_stop_requested = 1;
+}
+
+// Runs the VM for a fixed number of frames as fast as possible, without a window.
+// SIGINT and SIGTERM end the run after the current frame so the caller still
+// gets to finish the capture and unlink the shared memory segment
+int headless_run(VM *vm, const HeadlessConfig *config, HeadlessResult *result)
+{
+    Keyboard keyboard = {0};
+    InputQueue input = {0};
+    double instruction_budget = 0;
+
+    result->frames = 0;
+    result->instructions = 0;
+    result->error = VMERROR_OK;
+
+    headless_stop_requested = 0;
+    void (*previous_interrupt)(int) = signal(SIGINT, headless_request_stop);
+    void (*previous_terminate)(int) = signal(SIGTERM, headless_request_stop);
+
+    uint64_t start_cycles = vm->cycles;
+    double start = clock_now_ms();
+
+    while (result->frames < config->frames && !headless_stop_requested)
+    {
+        instruction_budget += (double)config->ips / TARGET_FPS;
+        unsigned int instructions = (unsigned int)instruction_budget;
+        instruction_budget -= instructions;
+
+        if (config->debugger != NULL && config->debugger->paused && debugger_prompt(config->debugger, vm) != 0)
+        {
+            break;
+        }
+
+        if (config->shared != NULL)
+        {
+            shared_state_begin_write(config->shared);
+        }
+
+        if (config->debugger != NULL)
+        {
+            result->error = debugger_run_frame(config->debugger, vm, &keyboard, &input, instructions);
+        }
+        else
+        {
+            result->error = vm_run_frame(vm, &keyboard, &input, instructions);
+        }
+
+        if (config->shared != NULL)
+        {
+            shared_state_end_write(config->shared);
+        }
+
+        if (result->error != VMERROR_OK)
+        {
+            if (config->debugger != NULL)
+            {
+                debugger_prompt(config->debugger, vm);
+            }
+            break;
+        }
+        result->frames++;
+
+        if (config->capture != NULL)
+        {
+            capture_frame(config->capture, &vm->display);
+        }
+
+        if (config->stream != NULL)
+        {
+            stream_server_broadcast(config->stream, &vm->display);
+        }
+    }
+
+    result->elapsed_ms = clock_now_ms() - start;
+    result->instructions = vm->cycles - start_cycles;
+
+    signal(SIGINT, previous_interrupt);
+    signal(SIGTERM, previous_terminate);
+
+    return result->error != VMERROR_OK;
+}
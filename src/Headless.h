@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "VM/VM.h"
+#include "Capture/Capture.h"
+#include "Share/SharedState.h"
+#include "Stream/StreamServer.h"
+#include "Debugger/Debugger.h"
+
+typedef struct
+{
+    uint64_t frames;
+    unsigned int ips;
+    Capture *capture;
+    SharedState *shared;
+    StreamServer *stream;
+    Debugger *debugger;
+} HeadlessConfig;
+
+typedef struct
+{
+    uint64_t frames;
+    uint64_t instructions;
+    double elapsed_ms;
+    VMError error;
+} HeadlessResult;
+
+int headless_run(VM *vm, const HeadlessConfig *config, HeadlessResult *result);
@@ -0,0 +1,681 @@
+#include "RomLibrary.h"
+
+#include <dirent.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define ROM_LIBRARY_PATH_LENGTH 4096
+
+const char *rom_flag_to_cstr(RomFlag flag)
+{
+    switch (flag)
+    {
+    case ROM_FLAG_SHIFT:
+        return "shift";
+    case ROM_FLAG_LOAD_STORE:
+        return "load-store";
+    case ROM_FLAG_JUMP_OFFSET:
+        return "jump-offset";
+    case ROM_FLAG_SUPERCHIP:
+        return "superchip";
+    case ROM_FLAG_TIMER_PACED:
+        return "timer-paced";
+    case ROM_FLAG_WAITS_KEY:
+        return "waits-key";
+    case ROM_FLAG_INVALID:
+        return "invalid";
+    }
+    return "unknown";
+}
+
+// FNV-1a, the same function the conformance suite hashes frames with
+uint64_t rom_hash(const uint8_t *data, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// Follows every path through the program from 0x200, so data (sprites,
+// tables) mixed in with the code doesn't produce false hints
+void rom_analyze(const uint8_t *data, size_t size, RomEntry *entry)
+{
+    uint8_t visited[ROM_LIBRARY_MAX_ROM_SIZE] = {0};
+    uint16_t pending[ROM_LIBRARY_MAX_ROM_SIZE * 2];
+    size_t pending_count = 0;
+    bool sets_timer = false;
+    bool reads_timer = false;
+
+    entry->flags = 0;
+    entry->reachable_instructions = 0;
+    pending[pending_count++] = 0x200;
+
+    while (pending_count > 0)
+    {
+        uint16_t address = pending[--pending_count];
+        size_t offset = (size_t)address - 0x200;
+        if (address < 0x200 || offset + 1 >= size || visited[offset])
+        {
+            continue;
+        }
+        visited[offset] = 1;
+        entry->reachable_instructions++;
+
+        uint16_t instruction = (uint16_t)(data[offset] << 8 | data[offset + 1]);
+        uint16_t NNN = instruction & 0x0FFF;
+        uint8_t NN = (uint8_t)(instruction & 0x00FF);
+        bool falls_through = true;
+        bool skips = false;
+
+        switch (instruction >> 12)
+        {
+        case 0x0:
+            if (instruction == 0x00EE || instruction == 0x00FD)
+            {
+                falls_through = false;
+            }
+            if ((instruction & 0xFFF0) == 0x00C0 || instruction >= 0x00FB)
+            {
+                entry->flags |= ROM_FLAG_SUPERCHIP;
+            }
+            break;
+        case 0x1:
+            pending[pending_count++] = NNN;
+            falls_through = false;
+            break;
+        case 0x2:
+            pending[pending_count++] = NNN;
+            break;
+        case 0x3:
+        case 0x4:
+        case 0x5:
+        case 0x9:
+            skips = true;
+            break;
+        case 0x8:
+            if ((instruction & 0xF) == 0x6 || (instruction & 0xF) == 0xE)
+            {
+                entry->flags |= ROM_FLAG_SHIFT;
+            }
+            else if ((instruction & 0xF) > 0x7)
+            {
+                entry->flags |= ROM_FLAG_INVALID;
+            }
+            break;
+        case 0xB:
+            entry->flags |= ROM_FLAG_JUMP_OFFSET;
+            falls_through = false;
+            break;
+        case 0xD:
+            if ((instruction & 0xF) == 0)
+            {
+                entry->flags |= ROM_FLAG_SUPERCHIP;
+            }
+            break;
+        case 0xE:
+            skips = NN == 0x9E || NN == 0xA1;
+            if (!skips)
+            {
+                entry->flags |= ROM_FLAG_INVALID;
+            }
+            break;
+        case 0xF:
+            switch (NN)
+            {
+            case 0x07:
+                reads_timer = true;
+                break;
+            case 0x15:
+                sets_timer = true;
+                break;
+            case 0x0A:
+                entry->flags |= ROM_FLAG_WAITS_KEY;
+                break;
+            case 0x55:
+            case 0x65:
+                entry->flags |= ROM_FLAG_LOAD_STORE;
+                break;
+            case 0x30:
+            case 0x75:
+            case 0x85:
+                entry->flags |= ROM_FLAG_SUPERCHIP;
+                break;
+            case 0x18:
+            case 0x1E:
+            case 0x29:
+            case 0x33:
+                break;
+            default:
+                entry->flags |= ROM_FLAG_INVALID;
+                break;
+            }
+            break;
+        default:
+            break;
+        }
+
+        if (skips)
+        {
+            pending[pending_count++] = (uint16_t)(address + 4);
+        }
+        if (falls_through)
+        {
+            pending[pending_count++] = (uint16_t)(address + 2);
+        }
+    }
+
+    if (sets_timer && reads_timer)
+    {
+        entry->flags |= ROM_FLAG_TIMER_PACED;
+    }
+
+    if (entry->flags & ROM_FLAGS_UNSUPPORTED)
+    {
+        entry->recommended_ips = ROM_UNSUPPORTED_IPS;
+    }
+    else
+    {
+        entry->recommended_ips = entry->flags & ROM_FLAG_TIMER_PACED ? ROM_DEFAULT_IPS : ROM_BUSY_LOOP_IPS;
+    }
+}
+
+static int rom_library_join(char *buffer, size_t size, const char *directory, const char *name)
+{
+    int length = snprintf(buffer, size, "%s/%s", directory, name);
+    return length < 0 || (size_t)length >= size;
+}
+
+static int rom_image_map_path(RomImage *image, const char *path)
+{
+    memset(image, 0, sizeof(RomImage));
+
+#ifdef _WIN32
+    FILE *file = fopen(path, "rb");
+    uint8_t *data = malloc(ROM_LIBRARY_MAX_ROM_SIZE + 1);
+    size_t size = file != NULL && data != NULL ? fread(data, 1, ROM_LIBRARY_MAX_ROM_SIZE + 1, file) : 0;
+    if (size == 0 || size > ROM_LIBRARY_MAX_ROM_SIZE)
+    {
+        fprintf(stderr, "ERROR: Unable to read ROM %s.\n", path);
+        if (file != NULL)
+        {
+            fclose(file);
+        }
+        free(data);
+        return 1;
+    }
+    fclose(file);
+    image->data = data;
+    image->size = size;
+#else
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || info.st_size <= 0 || info.st_size > ROM_LIBRARY_MAX_ROM_SIZE)
+    {
+        fprintf(stderr, "ERROR: Unable to open ROM %s.\n", path);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return 1;
+    }
+
+    void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        fprintf(stderr, "ERROR: Unable to map ROM %s.\n", path);
+        return 1;
+    }
+    image->data = data;
+    image->size = (size_t)info.st_size;
+    image->mapped = true;
+#endif
+
+    return 0;
+}
+
+int rom_image_map(RomImage *image, const RomLibrary *library, const RomEntry *entry)
+{
+    char path[ROM_LIBRARY_PATH_LENGTH];
+    if (rom_library_join(path, sizeof(path), library->root, rom_library_path(library, entry)) != 0)
+    {
+        fprintf(stderr, "ERROR: ROM path is too long.\n");
+        return 1;
+    }
+    return rom_image_map_path(image, path);
+}
+
+void rom_image_unmap(RomImage *image)
+{
+#ifndef _WIN32
+    if (image->mapped)
+    {
+        munmap((void *)image->data, image->size);
+    }
+    else
+#endif
+    {
+        free((void *)image->data);
+    }
+    memset(image, 0, sizeof(RomImage));
+}
+
+const char *rom_library_path(const RomLibrary *library, const RomEntry *entry)
+{
+    return library->strings + entry->path_offset;
+}
+
+static int rom_library_add(RomLibrary *library, size_t *capacity, size_t *strings_capacity, const RomEntry *entry, const char *path)
+{
+    size_t path_size = strlen(path) + 1;
+
+    if (library->count == *capacity)
+    {
+        *capacity = *capacity > 0 ? *capacity * 2 : 256;
+        RomEntry *entries = realloc(library->entries, *capacity * sizeof(RomEntry));
+        if (entries == NULL)
+        {
+            return 1;
+        }
+        library->entries = entries;
+    }
+
+    while (library->strings_size + path_size > *strings_capacity)
+    {
+        *strings_capacity = *strings_capacity > 0 ? *strings_capacity * 2 : 4096;
+        char *strings = realloc(library->strings, *strings_capacity);
+        if (strings == NULL)
+        {
+            return 1;
+        }
+        library->strings = strings;
+    }
+
+    library->entries[library->count] = *entry;
+    library->entries[library->count].path_offset = (uint32_t)library->strings_size;
+    memcpy(library->strings + library->strings_size, path, path_size);
+    library->strings_size += path_size;
+    library->count++;
+    return 0;
+}
+
+// The previous index, sorted by path so unchanged files can be looked up
+// without reading them
+typedef struct
+{
+    RomLibrary library;
+    const RomEntry **by_path;
+} RomIndex;
+
+static const RomLibrary *sort_library;
+
+static int rom_entry_compare_path(const void *a, const void *b)
+{
+    const RomEntry *left = *(const RomEntry *const *)a;
+    const RomEntry *right = *(const RomEntry *const *)b;
+    return strcmp(rom_library_path(sort_library, left), rom_library_path(sort_library, right));
+}
+
+static int rom_entry_compare_hash(const void *a, const void *b)
+{
+    const RomEntry *left = a;
+    const RomEntry *right = b;
+    if (left->hash != right->hash)
+    {
+        return left->hash < right->hash ? -1 : 1;
+    }
+    return strcmp(rom_library_path(sort_library, left), rom_library_path(sort_library, right));
+}
+
+static void rom_index_load(RomIndex *index, const char *root)
+{
+    memset(index, 0, sizeof(RomIndex));
+
+    char path[ROM_LIBRARY_PATH_LENGTH];
+    if (rom_library_join(path, sizeof(path), root, ROM_LIBRARY_INDEX_NAME) != 0)
+    {
+        return;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return;
+    }
+
+    RomIndexHeader header;
+    RomLibrary *library = &index->library;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == ROM_LIBRARY_INDEX_MAGIC &&
+                 header.version == ROM_LIBRARY_INDEX_VERSION && header.strings_size > 0;
+    if (valid)
+    {
+        library->count = header.entry_count;
+        library->strings_size = header.strings_size;
+        library->entries = malloc(library->count * sizeof(RomEntry) + 1);
+        library->strings = malloc(library->strings_size);
+        valid = library->entries != NULL && library->strings != NULL &&
+                fread(library->entries, sizeof(RomEntry), library->count, file) == library->count &&
+                fread(library->strings, 1, library->strings_size, file) == library->strings_size &&
+                library->strings[library->strings_size - 1] == '\0';
+    }
+    for (size_t i = 0; valid && i < library->count; i++)
+    {
+        valid = library->entries[i].path_offset < library->strings_size;
+    }
+    fclose(file);
+
+    if (valid)
+    {
+        index->by_path = malloc(library->count * sizeof(RomEntry *) + 1);
+        valid = index->by_path != NULL;
+    }
+    if (!valid)
+    {
+        fprintf(stderr, "Ignoring invalid library index %s\n", path);
+        free(library->entries);
+        free(library->strings);
+        free(index->by_path);
+        memset(index, 0, sizeof(RomIndex));
+        return;
+    }
+
+    for (size_t i = 0; i < library->count; i++)
+    {
+        index->by_path[i] = &library->entries[i];
+    }
+    sort_library = library;
+    qsort(index->by_path, library->count, sizeof(RomEntry *), rom_entry_compare_path);
+}
+
+static const RomEntry *rom_index_find(const RomIndex *index, const char *path)
+{
+    size_t low = 0;
+    size_t high = index->library.count;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        int order = strcmp(rom_library_path(&index->library, index->by_path[middle]), path);
+        if (order == 0)
+        {
+            return index->by_path[middle];
+        }
+        if (order < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return NULL;
+}
+
+typedef struct
+{
+    RomLibrary *library;
+    const RomIndex *index;
+    size_t capacity;
+    size_t strings_capacity;
+} RomScan;
+
+static int rom_library_scan(RomScan *scan, const char *relative)
+{
+    char directory_path[ROM_LIBRARY_PATH_LENGTH];
+    if (rom_library_join(directory_path, sizeof(directory_path), scan->library->root, relative) != 0)
+    {
+        return 0;
+    }
+
+    DIR *directory = opendir(directory_path);
+    if (directory == NULL)
+    {
+        fprintf(stderr, "ERROR: Unable to open library directory %s.\n", directory_path);
+        return 1;
+    }
+
+    int result = 0;
+    struct dirent *item;
+    while (result == 0 && (item = readdir(directory)) != NULL)
+    {
+        // Skips ., .. and the index itself
+        if (item->d_name[0] == '.')
+        {
+            continue;
+        }
+
+        char path[ROM_LIBRARY_PATH_LENGTH];
+        char full_path[ROM_LIBRARY_PATH_LENGTH];
+        struct stat info;
+        int length = relative[0] == '\0' ? snprintf(path, sizeof(path), "%s", item->d_name)
+                                          : snprintf(path, sizeof(path), "%s/%s", relative, item->d_name);
+        if (length < 0 || (size_t)length >= sizeof(path) ||
+            rom_library_join(full_path, sizeof(full_path), scan->library->root, path) != 0 ||
+            stat(full_path, &info) != 0)
+        {
+            continue;
+        }
+
+        if (S_ISDIR(info.st_mode))
+        {
+            result = rom_library_scan(scan, path);
+            continue;
+        }
+
+        if (!S_ISREG(info.st_mode) || info.st_size <= 0 || info.st_size > ROM_LIBRARY_MAX_ROM_SIZE)
+        {
+            continue;
+        }
+
+        const RomEntry *cached = rom_index_find(scan->index, path);
+        if (cached != NULL && cached->size == (uint32_t)info.st_size && cached->mtime == (int64_t)info.st_mtime)
+        {
+            scan->library->reused++;
+            result = rom_library_add(scan->library, &scan->capacity, &scan->strings_capacity, cached, path);
+            continue;
+        }
+
+        RomImage image;
+        if (rom_image_map_path(&image, full_path) != 0)
+        {
+            continue;
+        }
+
+        RomEntry entry = {.size = (uint32_t)image.size, .mtime = (int64_t)info.st_mtime};
+        entry.hash = rom_hash(image.data, image.size);
+        rom_analyze(image.data, image.size, &entry);
+        rom_image_unmap(&image);
+        scan->library->scanned++;
+        result = rom_library_add(scan->library, &scan->capacity, &scan->strings_capacity, &entry, path);
+    }
+
+    closedir(directory);
+    return result;
+}
+
+static int rom_library_write(const RomLibrary *library)
+{
+    char path[ROM_LIBRARY_PATH_LENGTH];
+    char temporary_path[ROM_LIBRARY_PATH_LENGTH];
+    if (rom_library_join(path, sizeof(path), library->root, ROM_LIBRARY_INDEX_NAME) != 0 ||
+        rom_library_join(temporary_path, sizeof(temporary_path), library->root, ROM_LIBRARY_INDEX_NAME ".tmp") != 0)
+    {
+        return 1;
+    }
+
+    // Written next to the index and renamed over it, so a reader never sees half an index
+    FILE *file = fopen(temporary_path, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "ERROR: Unable to write library index %s.\n", temporary_path);
+        return 1;
+    }
+
+    RomIndexHeader header = {
+        .magic = ROM_LIBRARY_INDEX_MAGIC,
+        .version = ROM_LIBRARY_INDEX_VERSION,
+        .entry_count = (uint32_t)library->count,
+        .strings_size = (uint32_t)library->strings_size,
+    };
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(library->entries, sizeof(RomEntry), library->count, file) == library->count &&
+                   fwrite(library->strings, 1, library->strings_size, file) == library->strings_size;
+    if (fclose(file) != 0 || !written || rename(temporary_path, path) != 0)
+    {
+        fprintf(stderr, "ERROR: Unable to write library index %s.\n", path);
+        remove(temporary_path);
+        return 1;
+    }
+
+    return 0;
+}
+
+// Indexes every ROM below root. Files whose size and modification time match
+// the on-disk index are not read again, so opening a known library only
+// costs a directory walk
+RomLibrary *rom_library_open(const char *root)
+{
+    RomLibrary *library = calloc(1, sizeof(RomLibrary));
+    if (library == NULL)
+    {
+        return NULL;
+    }
+
+    library->root = malloc(strlen(root) + 1);
+    if (library->root == NULL)
+    {
+        free(library);
+        return NULL;
+    }
+    strcpy(library->root, root);
+
+    RomIndex index;
+    rom_index_load(&index, root);
+
+    RomScan scan = {.library = library, .index = &index};
+    int result = rom_library_scan(&scan, "");
+
+    bool changed = library->scanned > 0 || library->count != index.library.count;
+    free(index.library.entries);
+    free(index.library.strings);
+    free(index.by_path);
+
+    if (result != 0)
+    {
+        rom_library_free(library);
+        return NULL;
+    }
+
+    sort_library = library;
+    qsort(library->entries, library->count, sizeof(RomEntry), rom_entry_compare_hash);
+
+    // A read-only library still works, it just gets rescanned next time
+    if (changed)
+    {
+        rom_library_write(library);
+    }
+
+    return library;
+}
+
+void rom_library_free(RomLibrary *library)
+{
+    if (library == NULL)
+    {
+        return;
+    }
+
+    free(library->root);
+    free(library->entries);
+    free(library->strings);
+    free(library);
+}
+
+// Looks a ROM up by a prefix of its hash (at least 4 hex digits), its path
+// inside the library or its file name
+const RomEntry *rom_library_find(const RomLibrary *library, const char *query)
+{
+    size_t length = strlen(query);
+    bool is_hash = length >= 4 && length <= 16 && strspn(query, "0123456789abcdefABCDEF") == length;
+
+    const RomEntry *match = NULL;
+    size_t matches = 0;
+    if (is_hash)
+    {
+        unsigned int shift = (unsigned int)(16 - length) * 4;
+        uint64_t prefix = strtoull(query, NULL, 16);
+        for (size_t i = 0; i < library->count; i++)
+        {
+            if ((library->entries[i].hash >> shift) == prefix && (match == NULL || match->hash != library->entries[i].hash))
+            {
+                match = &library->entries[i];
+                matches++;
+            }
+        }
+    }
+
+    for (size_t i = 0; matches == 0 && i < library->count; i++)
+    {
+        const char *path = rom_library_path(library, &library->entries[i]);
+        const char *name = strrchr(path, '/');
+        if (strcmp(path, query) == 0 || (name != NULL && strcmp(name + 1, query) == 0))
+        {
+            match = &library->entries[i];
+            matches++;
+        }
+    }
+
+    if (matches == 0)
+    {
+        fprintf(stderr, "ERROR: No ROM matching %s in library %s.\n", query, library->root);
+        return NULL;
+    }
+    if (matches > 1)
+    {
+        fprintf(stderr, "ERROR: %s matches %zu ROMs, be more specific.\n", query, matches);
+        return NULL;
+    }
+
+    return match;
+}
+
+void rom_library_print(const RomLibrary *library, FILE *stream)
+{
+    fprintf(stream, "%-16s %5s %5s %6s  %-40s %s\n", "hash", "size", "ips", "insts", "flags", "path");
+    for (size_t i = 0; i < library->count; i++)
+    {
+        const RomEntry *entry = &library->entries[i];
+
+        char flags[128] = "-";
+        size_t length = 0;
+        for (int bit = 0; bit < ROM_FLAG_COUNT; bit++)
+        {
+            if (entry->flags & (1 << bit))
+            {
+                length += (size_t)snprintf(flags + length, sizeof(flags) - length, "%s%s", length > 0 ? "," : "", rom_flag_to_cstr((RomFlag)(1 << bit)));
+            }
+        }
+
+        char ips[16] = "-";
+        if (entry->recommended_ips != ROM_UNSUPPORTED_IPS)
+        {
+            snprintf(ips, sizeof(ips), "%" PRIu32, entry->recommended_ips);
+        }
+
+        fprintf(stream, "%016" PRIx64 " %5" PRIu32 " %5s %6" PRIu16 "  %-40s %s\n", entry->hash, entry->size, ips,
+                entry->reachable_instructions, flags, rom_library_path(library, entry));
+    }
+    fprintf(stream, "%zu ROMs, %zu analyzed, %zu from the index\n", library->count, library->scanned, library->reused);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define ROM_LIBRARY_INDEX_NAME ".chip8-index"
+#define ROM_LIBRARY_INDEX_MAGIC 0x58494C43 // "CLIX"
+#define ROM_LIBRARY_INDEX_VERSION 2
+#define ROM_LIBRARY_MAX_ROM_SIZE (4096 - 0x200)
+
+// ROMs that wait on the delay timer run at the same pace at any speed, the
+// others were tuned against the speed of the original interpreter
+#define ROM_DEFAULT_IPS 800
+#define ROM_BUSY_LOOP_IPS 500
+// recommended_ips of ROMs this VM can't run
+#define ROM_UNSUPPORTED_IPS 0
+
+// Hints from static analysis of the instructions reachable from 0x200
+typedef enum
+{
+    ROM_FLAG_SHIFT = 1 << 0,      // 8XY6/8XYE, behaviour differs between interpreters
+    ROM_FLAG_LOAD_STORE = 1 << 1, // FX55/FX65, whether I is incremented differs
+    ROM_FLAG_JUMP_OFFSET = 1 << 2, // BNNN, target can't be followed statically
+    ROM_FLAG_SUPERCHIP = 1 << 3,  // Uses SUPER-CHIP instructions this VM doesn't implement, unsupported
+    ROM_FLAG_TIMER_PACED = 1 << 4, // Sets and reads the delay timer
+    ROM_FLAG_WAITS_KEY = 1 << 5,  // FX0A
+    ROM_FLAG_INVALID = 1 << 6,    // An unknown opcode is reachable, unsupported
+} RomFlag;
+
+#define ROM_FLAG_COUNT 7
+#define ROM_FLAGS_UNSUPPORTED (ROM_FLAG_SUPERCHIP | ROM_FLAG_INVALID)
+
+// Fixed size so the index is an array of these written as is
+typedef struct
+{
+    uint64_t hash;
+    int64_t mtime;
+    uint32_t size;
+    uint32_t path_offset;
+    uint32_t recommended_ips;
+    uint16_t flags;
+    uint16_t reachable_instructions;
+} RomEntry;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t strings_size;
+} RomIndexHeader;
+
+typedef struct
+{
+    char *root;
+    RomEntry *entries; // Sorted by hash
+    size_t count;
+    char *strings; // Paths relative to root, referenced by path_offset
+    size_t strings_size;
+    size_t scanned;
+    size_t reused;
+} RomLibrary;
+
+typedef struct
+{
+    const uint8_t *data;
+    size_t size;
+    bool mapped;
+} RomImage;
+
+RomLibrary *rom_library_open(const char *root);
+void rom_library_free(RomLibrary *library);
+const RomEntry *rom_library_find(const RomLibrary *library, const char *query);
+const char *rom_library_path(const RomLibrary *library, const RomEntry *entry);
+void rom_library_print(const RomLibrary *library, FILE *stream);
+
+int rom_image_map(RomImage *image, const RomLibrary *library, const RomEntry *entry);
+void rom_image_unmap(RomImage *image);
+
+uint64_t rom_hash(const uint8_t *data, size_t size);
+void rom_analyze(const uint8_t *data, size_t size, RomEntry *entry);
+const char *rom_flag_to_cstr(RomFlag flag);
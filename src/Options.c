@@ -0,0 +1,262 @@
+#include "Options.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void print_usage(void)
+{
+    printf("Usage: chip8 [options] <path-to-rom>\n");
+    printf("       chip8 --grid [options] <path-to-rom>...\n");
+    printf("       chip8 --conformance <manifest> [options]\n");
+    printf("       chip8 --library <directory> [options] [hash-or-name]\n");
+    printf("\n");
+    printf("Options:\n");
+    printf("  --latency              Report key press to next changed frame latency on exit\n");
+    printf("  --no-vsync             Pace frames with timed sleeps instead of the display's vsync\n");
+    printf("  --frame-stats          Report frame time jitter on exit\n");
+    printf("  --filter NAME          Upscaling filter: none, scale2x, epx, scale3x, scanlines, phosphor\n");
+    printf("  --ips N                Instructions per second (default %i)\n", TARGET_IPS);
+    printf("  --headless             Run without a window as fast as possible\n");
+    printf("  --frames N             Frames to run in headless mode (default %i)\n", HEADLESS_DEFAULT_FRAMES);
+    printf("  --capture PATH         Record every frame to PATH (a file name prefix for png)\n");
+    printf("  --capture-format NAME  Capture format: y4m, raw, png (default y4m)\n");
+    printf("  --shm NAME             Export the running VM in POSIX shared memory segment NAME\n");
+    printf("  --serve ADDRESS        Stream the display to viewers on unix:PATH or tcp:HOST:PORT\n");
+    printf("  --debug                Start in the debugger, F12 breaks into it while running\n");
+    printf("  --grid                 Run every ROM given in one window\n");
+    printf("  --threads N            Worker threads for --grid and --conformance (default: one per CPU)\n");
+    printf("  --conformance FILE     Check every ROM of a manifest against its golden hash and speed\n");
+    printf("  --update-golden        Rewrite the manifest's hashes and baselines from this run\n");
+    printf("  --tolerance PCT        Allowed slowdown against the baseline (default %.0f%%)\n", CONFORMANCE_DEFAULT_TOLERANCE);
+    printf("  --library DIR          Index the ROMs below DIR, list them or run one by hash or name\n");
+}
+
+// Parses a positive integer no larger than max. strtoull alone would accept
+// "-1" and wrap it around
+int parse_number(const char *option, const char *value, unsigned long long max, unsigned long long *number)
+{
+    char *end = NULL;
+    if (value == NULL || *value == '\0')
+    {
+        fprintf(stderr, "ERROR: %s expects a number\n", option);
+        return 1;
+    }
+
+    if (!isdigit((unsigned char)*value))
+    {
+        fprintf(stderr, "ERROR: %s expects a positive number, got %s\n", option, value);
+        return 1;
+    }
+
+    errno = 0;
+    *number = strtoull(value, &end, 10);
+    if (*end != '\0' || *number == 0)
+    {
+        fprintf(stderr, "ERROR: %s expects a positive number, got %s\n", option, value);
+        return 1;
+    }
+
+    if (errno == ERANGE || *number > max)
+    {
+        fprintf(stderr, "ERROR: %s is out of range, got %s but at most %llu is supported\n", option, value, max);
+        return 1;
+    }
+    return 0;
+}
+
+int parse_options(Options *options, int argc, char *argv[])
+{
+    options->ips = TARGET_IPS;
+    options->frames = HEADLESS_DEFAULT_FRAMES;
+    options->tolerance = CONFORMANCE_DEFAULT_TOLERANCE;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+
+        if (strcmp(arg, "--latency") == 0)
+        {
+            options->measure_latency = true;
+        }
+        else if (strcmp(arg, "--no-vsync") == 0)
+        {
+            options->no_vsync = true;
+        }
+        else if (strcmp(arg, "--frame-stats") == 0)
+        {
+            options->frame_stats = true;
+        }
+        else if (strcmp(arg, "--filter") == 0)
+        {
+            if (i + 1 >= argc || filter_from_cstr(argv[i + 1], &options->filter) != 0)
+            {
+                fprintf(stderr, "ERROR: --filter expects one of none, scale2x, epx, scale3x, scanlines, phosphor\n");
+                return 1;
+            }
+            i++;
+        }
+        else if (strcmp(arg, "--ips") == 0)
+        {
+            unsigned long long ips;
+            if (parse_number(arg, i + 1 < argc ? argv[i + 1] : NULL, UINT_MAX, &ips) != 0)
+            {
+                return 1;
+            }
+            options->ips = (unsigned int)ips;
+            options->custom_ips = true;
+            i++;
+        }
+        else if (strcmp(arg, "--headless") == 0)
+        {
+            options->headless = true;
+        }
+        else if (strcmp(arg, "--frames") == 0)
+        {
+            unsigned long long frames;
+            if (parse_number(arg, i + 1 < argc ? argv[i + 1] : NULL, UINT64_MAX, &frames) != 0)
+            {
+                return 1;
+            }
+            options->frames = frames;
+            i++;
+        }
+        else if (strcmp(arg, "--capture") == 0)
+        {
+            if (i + 1 >= argc)
+            {
+                fprintf(stderr, "ERROR: --capture expects a path\n");
+                return 1;
+            }
+            options->capture_path = argv[++i];
+        }
+        else if (strcmp(arg, "--capture-format") == 0)
+        {
+            if (i + 1 >= argc || capture_format_from_cstr(argv[i + 1], &options->capture_format) != 0)
+            {
+                fprintf(stderr, "ERROR: --capture-format expects one of y4m, raw, png\n");
+                return 1;
+            }
+            i++;
+        }
+        else if (strcmp(arg, "--shm") == 0)
+        {
+            if (i + 1 >= argc)
+            {
+                fprintf(stderr, "ERROR: --shm expects a segment name such as /chip8\n");
+                return 1;
+            }
+            options->shm_name = argv[++i];
+        }
+        else if (strcmp(arg, "--serve") == 0)
+        {
+            if (i + 1 >= argc)
+            {
+                fprintf(stderr, "ERROR: --serve expects unix:PATH or tcp:HOST:PORT\n");
+                return 1;
+            }
+            options->serve_address = argv[++i];
+        }
+        else if (strcmp(arg, "--debug") == 0)
+        {
+            options->debug = true;
+        }
+        else if (strcmp(arg, "--grid") == 0)
+        {
+            options->grid = true;
+        }
+        else if (strcmp(arg, "--threads") == 0)
+        {
+            unsigned long long threads;
+            if (parse_number(arg, i + 1 < argc ? argv[i + 1] : NULL, UINT_MAX, &threads) != 0)
+            {
+                return 1;
+            }
+            options->threads = (unsigned int)threads;
+            i++;
+        }
+        else if (strcmp(arg, "--conformance") == 0)
+        {
+            if (i + 1 >= argc)
+            {
+                fprintf(stderr, "ERROR: --conformance expects a manifest path\n");
+                return 1;
+            }
+            options->conformance_manifest = argv[++i];
+        }
+        else if (strcmp(arg, "--library") == 0)
+        {
+            if (i + 1 >= argc)
+            {
+                fprintf(stderr, "ERROR: --library expects a directory\n");
+                return 1;
+            }
+            options->library_path = argv[++i];
+        }
+        else if (strcmp(arg, "--update-golden") == 0)
+        {
+            options->update_golden = true;
+        }
+        else if (strcmp(arg, "--tolerance") == 0)
+        {
+            char *end = NULL;
+            const char *value = i + 1 < argc ? argv[i + 1] : "";
+            options->tolerance = strtod(value, &end);
+            if (*value == '\0' || *end != '\0' || !isfinite(options->tolerance) || options->tolerance < 0 || options->tolerance > 100)
+            {
+                fprintf(stderr, "ERROR: --tolerance expects a percentage between 0 and 100\n");
+                return 1;
+            }
+            i++;
+        }
+        else if (strncmp(arg, "--", 2) == 0)
+        {
+            fprintf(stderr, "ERROR: Unknown option %s\n", arg);
+            return 1;
+        }
+        else if (options->rom_count < OPTIONS_MAX_ROMS)
+        {
+            options->rom_paths[options->rom_count++] = arg;
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: Too many ROMs, at most %i are supported\n", OPTIONS_MAX_ROMS);
+            return 1;
+        }
+    }
+
+    if (options->conformance_manifest != NULL)
+    {
+        if (options->rom_count > 0)
+        {
+            fprintf(stderr, "ERROR: Unexpected argument %s, --conformance reads its ROMs from the manifest\n", options->rom_paths[0]);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (options->rom_count == 0 && options->library_path == NULL)
+    {
+        return 1;
+    }
+
+    if (options->library_path != NULL && options->grid)
+    {
+        fprintf(stderr, "ERROR: --library can't be combined with --grid\n");
+        return 1;
+    }
+
+    if (options->rom_count > 1 && !options->grid)
+    {
+        fprintf(stderr, "ERROR: Unexpected argument %s, use --grid to run several ROMs\n", options->rom_paths[1]);
+        return 1;
+    }
+
+    options->rom_path = options->rom_paths[0];
+
+    return 0;
+}
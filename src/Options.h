@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Rendering/Filters.h"
+#include "Capture/Capture.h"
+
+#define TARGET_FPS 60
+#define TARGET_IPS 800
+#define HEADLESS_DEFAULT_FRAMES 600
+#define OPTIONS_MAX_ROMS 256
+#define CONFORMANCE_DEFAULT_TOLERANCE 10.0
+
+typedef struct
+{
+    const char *rom_path;
+    const char *rom_paths[OPTIONS_MAX_ROMS];
+    size_t rom_count;
+    bool measure_latency;
+    bool no_vsync;
+    bool frame_stats;
+    Filter filter;
+    unsigned int ips;
+    bool headless;
+    uint64_t frames;
+    const char *capture_path;
+    CaptureFormat capture_format;
+    const char *shm_name;
+    const char *serve_address;
+    bool grid;
+    bool debug;
+    unsigned int threads;
+    const char *conformance_manifest;
+    bool update_golden;
+    double tolerance;
+    const char *library_path;
+    bool custom_ips;
+} Options;
+
+int parse_options(Options *options, int argc, char *argv[]);
+int parse_number(const char *option, const char *value, unsigned long long max, unsigned long long *number);
+void print_usage(void);
@@ -1,16 +1,38 @@
 #include "DisplayRenderer.h"
 #include "math.h"
 
-#define SCREEN_MARGIN 15
-#define PIXEL_MARGIN 0
+static int ensure_display_texture(RenderContext *context, int width, int height)
+{
+    if (context->texture != NULL && context->texture_width == width && context->texture_height == height)
+    {
+        return 0;
+    }
+
+    if (context->texture != NULL)
+    {
+        SDL_DestroyTexture(context->texture);
+    }
+
+    context->texture = SDL_CreateTexture(context->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+    if (context->texture == NULL)
+    {
+        fprintf(stderr, "ERROR: Failed to create display texture: %s\n", SDL_GetError());
+        return 1;
+    }
 
-void render_display(RenderContext *context, Display *display)
+    SDL_SetTextureScaleMode(context->texture, SDL_ScaleModeNearest);
+    context->texture_width = width;
+    context->texture_height = height;
+    return 0;
+}
+
+// Letterboxes an ARGB8888 image into the window at the given aspect ratio
+void render_pixels(RenderContext *context, const uint32_t *pixels, int width, int height, float aspect_ratio)
 {
     int window_width, window_height;
     SDL_GetWindowSize(context->window, &window_width, &window_height);
 
     float display_width, display_height;
-    float aspect_ratio = (float)VM_DISPLAY_WIDTH / (float)VM_DISPLAY_HEIGHT;
     if ((float)window_width / (float)window_height > aspect_ratio)
     {
         display_width = (float)window_height * aspect_ratio;
@@ -22,34 +44,32 @@ void render_display(RenderContext *context, Display *display)
         display_height = (float)window_width / aspect_ratio;
     }
 
-    float left_margin = roundf(((float)window_width - display_width) / 2.0f - SCREEN_MARGIN);
-    float top_margin = roundf(((float)window_height - display_height) / 2.0f - SCREEN_MARGIN);
-
     SDL_SetRenderDrawColor(context->renderer, 0, 0, 0, 255);
-    SDL_RenderFillRect(context->renderer, NULL);
+    SDL_RenderClear(context->renderer);
 
-    for (int y = 0; y < VM_DISPLAY_HEIGHT; y++)
+    if (ensure_display_texture(context, width, height) != 0)
     {
-        for (int x = 0; x < VM_DISPLAY_WIDTH; x++)
-        {
-            if (display->pixels[y][x])
-            {
-                SDL_SetRenderDrawColor(context->renderer, 255, 255, 255, 255);
-            }
-            else
-            {
-                SDL_SetRenderDrawColor(context->renderer, 10, 10, 10, 255);
-            }
-
-            int pixel_x = (int)roundf(left_margin + SCREEN_MARGIN + PIXEL_MARGIN + ((float)display_width / (float)VM_DISPLAY_WIDTH) * (float)x);
-            int pixel_y = (int)roundf(top_margin + SCREEN_MARGIN + PIXEL_MARGIN + ((float)display_height / (float)VM_DISPLAY_HEIGHT) * (float)y);
-            int pixel_w = (int)roundf((float)display_width / (float)VM_DISPLAY_WIDTH) - 2 * PIXEL_MARGIN;
-            int pixel_h = (int)roundf((float)display_height / (float)VM_DISPLAY_HEIGHT) - 2 * PIXEL_MARGIN;
-
-            SDL_Rect pixel_rect = {pixel_x, pixel_y, pixel_w, pixel_h};
-            SDL_RenderFillRect(context->renderer, &pixel_rect);
-        }
+        return;
     }
 
-    SDL_RenderPresent(context->renderer);
-}
\ No newline at end of file
+    SDL_UpdateTexture(context->texture, NULL, pixels, width * (int)sizeof(uint32_t));
+
+    SDL_Rect destination = {
+        (int)roundf(((float)window_width - display_width) / 2.0f),
+        (int)roundf(((float)window_height - display_height) / 2.0f),
+        (int)roundf(display_width),
+        (int)roundf(display_height),
+    };
+    SDL_RenderCopy(context->renderer, context->texture, NULL, &destination);
+}
+
+void render_display(RenderContext *context, FilterState *filter, Display *display)
+{
+    uint64_t start = SDL_GetPerformanceCounter();
+    filter_apply(filter, display);
+    filter->apply_ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+
+    // Filters change the resolution, but never the shape of the screen
+    float aspect_ratio = (float)VM_DISPLAY_WIDTH / (float)VM_DISPLAY_HEIGHT;
+    render_pixels(context, filter->pixels, filter->width, filter->height, aspect_ratio);
+}
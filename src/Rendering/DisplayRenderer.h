@@ -1,6 +1,8 @@
 #pragma once
 
 #include "RenderContext.h"
+#include "Filters.h"
 #include "../VM/Display.h"
 
-void render_display(RenderContext *context, Display *display);
\ No newline at end of file
+void render_display(RenderContext *context, FilterState *filter, Display *display);
+void render_pixels(RenderContext *context, const uint32_t *pixels, int width, int height, float aspect_ratio);
\ No newline at end of file
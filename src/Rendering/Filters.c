@@ -0,0 +1,306 @@
+#include "Filters.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define FILTER_COLOR_ON 0xFFFFFFFF
+#define FILTER_COLOR_OFF 0xFF0A0A0A
+#define FILTER_COLOR_SCANLINE_ON 0xFF8C8C8C
+#define FILTER_COLOR_SCANLINE_OFF 0xFF050505
+
+// Fraction of the previous intensity a phosphor pixel keeps each frame, out of 256
+#define FILTER_PHOSPHOR_DECAY 176
+
+const char *filter_to_cstr(Filter filter)
+{
+    switch (filter)
+    {
+    case FILTER_NONE:
+        return "none";
+    case FILTER_SCALE2X:
+        return "scale2x";
+    case FILTER_SCALE3X:
+        return "scale3x";
+    case FILTER_SCANLINES:
+        return "scanlines";
+    case FILTER_PHOSPHOR:
+        return "phosphor";
+    case FILTER_COUNT:
+    default:
+        return "filter_to_cstr unknown filter";
+    }
+}
+
+int filter_from_cstr(const char *name, Filter *filter)
+{
+    // EPX and Scale2x are the same algorithm
+    if (strcmp(name, "epx") == 0)
+    {
+        *filter = FILTER_SCALE2X;
+        return 0;
+    }
+
+    for (int i = 0; i < FILTER_COUNT; i++)
+    {
+        if (strcmp(name, filter_to_cstr((Filter)i)) == 0)
+        {
+            *filter = (Filter)i;
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+FilterState *filter_state_new(Filter filter)
+{
+    FilterState *state = calloc(1, sizeof(FilterState));
+    if (state == NULL)
+    {
+        return NULL;
+    }
+
+    state->filter = filter;
+    switch (filter)
+    {
+    case FILTER_SCALE2X:
+        state->width = VM_DISPLAY_WIDTH * 2;
+        state->height = VM_DISPLAY_HEIGHT * 2;
+        break;
+    case FILTER_SCALE3X:
+        state->width = VM_DISPLAY_WIDTH * 3;
+        state->height = VM_DISPLAY_HEIGHT * 3;
+        break;
+    case FILTER_SCANLINES:
+        state->width = VM_DISPLAY_WIDTH;
+        state->height = VM_DISPLAY_HEIGHT * 2;
+        break;
+    case FILTER_NONE:
+    case FILTER_PHOSPHOR:
+    case FILTER_COUNT:
+    default:
+        state->width = VM_DISPLAY_WIDTH;
+        state->height = VM_DISPLAY_HEIGHT;
+        break;
+    }
+
+    return state;
+}
+
+void filter_state_free(FilterState *state)
+{
+    free(state);
+}
+
+// Writes one color per bit, lowest bit first
+void filter_expand_bits(const uint64_t *bits, int count, uint32_t *out, uint32_t on, uint32_t off)
+{
+#ifdef __SSE2__
+    const __m128i select = _mm_set_epi32(8, 4, 2, 1);
+    const __m128i on_color = _mm_set1_epi32((int)on);
+    const __m128i off_color = _mm_set1_epi32((int)off);
+    for (int i = 0; i < count; i += 4)
+    {
+        int nibble = (int)((bits[i / 64] >> (i % 64)) & 0xF);
+        __m128i lit = _mm_and_si128(_mm_set1_epi32(nibble), select);
+        __m128i mask = _mm_cmpeq_epi32(lit, select);
+        __m128i color = _mm_or_si128(_mm_and_si128(mask, on_color), _mm_andnot_si128(mask, off_color));
+        _mm_storeu_si128((__m128i *)&out[i], color);
+    }
+#else
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t lit = (uint32_t)((bits[i / 64] >> (i % 64)) & 1);
+        out[i] = off ^ ((on ^ off) & (0u - lit));
+    }
+#endif
+}
+
+// Spreads the low 32 bits of value over the even bits of the result
+static uint64_t filter_spread2(uint64_t value)
+{
+    value &= 0xFFFFFFFF;
+    value = (value | (value << 16)) & 0x0000FFFF0000FFFFULL;
+    value = (value | (value << 8)) & 0x00FF00FF00FF00FFULL;
+    value = (value | (value << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    value = (value | (value << 2)) & 0x3333333333333333ULL;
+    value = (value | (value << 1)) & 0x5555555555555555ULL;
+    return value;
+}
+
+static void filter_interleave2(uint64_t a, uint64_t b, uint64_t out[2])
+{
+    out[0] = filter_spread2(a) | (filter_spread2(b) << 1);
+    out[1] = filter_spread2(a >> 32) | (filter_spread2(b >> 32) << 1);
+}
+
+static void filter_interleave3(uint64_t a, uint64_t b, uint64_t c, uint64_t out[3])
+{
+    out[0] = out[1] = out[2] = 0;
+    for (int x = 0; x < VM_DISPLAY_WIDTH; x++)
+    {
+        int bit = x * 3;
+        out[bit / 64] |= ((a >> x) & 1) << (bit % 64);
+        out[(bit + 1) / 64] |= ((b >> x) & 1) << ((bit + 1) % 64);
+        out[(bit + 2) / 64] |= ((c >> x) & 1) << ((bit + 2) % 64);
+    }
+}
+
+// The pixel art scalers work on whole packed rows at once: every rule of the
+// original per-pixel algorithm becomes a handful of 64 bit logic operations.
+#define EQ(a, b) (~((a) ^ (b)))
+#define NE(a, b) ((a) ^ (b))
+#define SELECT(condition, a, b) (((condition) & (a)) | (~(condition) & (b)))
+
+static uint64_t filter_left(uint64_t row)
+{
+    return (row << 1) | (row & 1);
+}
+
+static uint64_t filter_right(uint64_t row)
+{
+    return (row >> 1) | (row & 0x8000000000000000ULL);
+}
+
+static void filter_scale2x(FilterState *state, const uint64_t rows[VM_DISPLAY_HEIGHT])
+{
+    for (int y = 0; y < VM_DISPLAY_HEIGHT; y++)
+    {
+        uint64_t B = rows[y > 0 ? y - 1 : y];
+        uint64_t H = rows[y < VM_DISPLAY_HEIGHT - 1 ? y + 1 : y];
+        uint64_t E = rows[y];
+        uint64_t D = filter_left(E);
+        uint64_t F = filter_right(E);
+
+        uint64_t E0 = SELECT(EQ(D, B) & NE(B, F) & NE(D, H), D, E);
+        uint64_t E1 = SELECT(EQ(B, F) & NE(B, D) & NE(F, H), F, E);
+        uint64_t E2 = SELECT(EQ(D, H) & NE(D, B) & NE(H, F), D, E);
+        uint64_t E3 = SELECT(EQ(H, F) & NE(D, H) & NE(B, F), F, E);
+
+        uint64_t out[2];
+        filter_interleave2(E0, E1, out);
+        filter_expand_bits(out, state->width, &state->pixels[(y * 2) * state->width], FILTER_COLOR_ON, FILTER_COLOR_OFF);
+        filter_interleave2(E2, E3, out);
+        filter_expand_bits(out, state->width, &state->pixels[(y * 2 + 1) * state->width], FILTER_COLOR_ON, FILTER_COLOR_OFF);
+    }
+}
+
+static void filter_scale3x(FilterState *state, const uint64_t rows[VM_DISPLAY_HEIGHT])
+{
+    for (int y = 0; y < VM_DISPLAY_HEIGHT; y++)
+    {
+        uint64_t above = rows[y > 0 ? y - 1 : y];
+        uint64_t below = rows[y < VM_DISPLAY_HEIGHT - 1 ? y + 1 : y];
+        uint64_t A = filter_left(above), B = above, C = filter_right(above);
+        uint64_t D = filter_left(rows[y]), E = rows[y], F = filter_right(rows[y]);
+        uint64_t G = filter_left(below), H = below, I = filter_right(below);
+
+        uint64_t top_left = EQ(D, B) & NE(B, F) & NE(D, H);
+        uint64_t top_right = EQ(B, F) & NE(B, D) & NE(F, H);
+        uint64_t bottom_left = EQ(D, H) & NE(D, B) & NE(H, F);
+        uint64_t bottom_right = EQ(H, F) & NE(D, H) & NE(B, F);
+
+        uint64_t E0 = SELECT(top_left, D, E);
+        uint64_t E1 = SELECT((top_left & NE(E, C)) | (top_right & NE(E, A)), B, E);
+        uint64_t E2 = SELECT(top_right, F, E);
+        uint64_t E3 = SELECT((top_left & NE(E, G)) | (bottom_left & NE(E, A)), D, E);
+        uint64_t E5 = SELECT((top_right & NE(E, I)) | (bottom_right & NE(E, C)), F, E);
+        uint64_t E6 = SELECT(bottom_left, D, E);
+        uint64_t E7 = SELECT((bottom_left & NE(E, I)) | (bottom_right & NE(E, G)), H, E);
+        uint64_t E8 = SELECT(bottom_right, F, E);
+
+        uint64_t out[3];
+        filter_interleave3(E0, E1, E2, out);
+        filter_expand_bits(out, state->width, &state->pixels[(y * 3) * state->width], FILTER_COLOR_ON, FILTER_COLOR_OFF);
+        filter_interleave3(E3, E, E5, out);
+        filter_expand_bits(out, state->width, &state->pixels[(y * 3 + 1) * state->width], FILTER_COLOR_ON, FILTER_COLOR_OFF);
+        filter_interleave3(E6, E7, E8, out);
+        filter_expand_bits(out, state->width, &state->pixels[(y * 3 + 2) * state->width], FILTER_COLOR_ON, FILTER_COLOR_OFF);
+    }
+}
+
+#undef EQ
+#undef NE
+#undef SELECT
+
+static void filter_scanlines(FilterState *state, const uint64_t rows[VM_DISPLAY_HEIGHT])
+{
+    for (int y = 0; y < VM_DISPLAY_HEIGHT; y++)
+    {
+        filter_expand_bits(&rows[y], state->width, &state->pixels[(y * 2) * state->width], FILTER_COLOR_ON, FILTER_COLOR_OFF);
+        filter_expand_bits(&rows[y], state->width, &state->pixels[(y * 2 + 1) * state->width], FILTER_COLOR_SCANLINE_ON, FILTER_COLOR_SCANLINE_OFF);
+    }
+}
+
+// Lit pixels jump to full intensity and fade out over a few frames, which hides
+// the flicker of games that erase and redraw sprites with XOR every frame
+static void filter_phosphor(FilterState *state, const Display *display)
+{
+    const uint8_t *pixels = (const uint8_t *)display->pixels;
+    uint8_t *persistence = state->persistence;
+    const int count = VM_DISPLAY_WIDTH * VM_DISPLAY_HEIGHT;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i decay = _mm_set1_epi16(FILTER_PHOSPHOR_DECAY);
+    for (int i = 0; i < count; i += 16)
+    {
+        __m128i lit = _mm_cmpgt_epi8(_mm_loadu_si128((const __m128i *)&pixels[i]), zero);
+        __m128i previous = _mm_loadu_si128((const __m128i *)&persistence[i]);
+        __m128i low = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(previous, zero), decay), 8);
+        __m128i high = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(previous, zero), decay), 8);
+        __m128i faded = _mm_packus_epi16(low, high);
+        _mm_storeu_si128((__m128i *)&persistence[i], _mm_max_epu8(faded, lit));
+    }
+#else
+    for (int i = 0; i < count; i++)
+    {
+        uint8_t faded = (uint8_t)((persistence[i] * FILTER_PHOSPHOR_DECAY) >> 8);
+        uint8_t lit = (uint8_t)(0u - (pixels[i] != 0));
+        persistence[i] = faded > lit ? faded : lit;
+    }
+#endif
+
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t level = 10u + (uint32_t)persistence[i] * 245u / 255u;
+        state->pixels[i] = 0xFF000000 | (level << 16) | (level << 8) | level;
+    }
+}
+
+void filter_apply(FilterState *state, const Display *display)
+{
+    uint64_t rows[VM_DISPLAY_HEIGHT];
+
+    switch (state->filter)
+    {
+    case FILTER_SCALE2X:
+        display_pack_rows(display, rows);
+        filter_scale2x(state, rows);
+        break;
+    case FILTER_SCALE3X:
+        display_pack_rows(display, rows);
+        filter_scale3x(state, rows);
+        break;
+    case FILTER_SCANLINES:
+        display_pack_rows(display, rows);
+        filter_scanlines(state, rows);
+        break;
+    case FILTER_PHOSPHOR:
+        filter_phosphor(state, display);
+        break;
+    case FILTER_NONE:
+    case FILTER_COUNT:
+    default:
+        display_pack_rows(display, rows);
+        for (int y = 0; y < VM_DISPLAY_HEIGHT; y++)
+        {
+            filter_expand_bits(&rows[y], state->width, &state->pixels[y * state->width], FILTER_COLOR_ON, FILTER_COLOR_OFF);
+        }
+        break;
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "../VM/Display.h"
+
+#define FILTER_MAX_SCALE 3
+
+typedef enum Filter
+{
+    FILTER_NONE = 0,
+    FILTER_SCALE2X,
+    FILTER_SCALE3X,
+    FILTER_SCANLINES,
+    FILTER_PHOSPHOR,
+    FILTER_COUNT
+} Filter;
+
+// Output of the selected filter as ARGB8888, ready to be uploaded to a streaming texture
+typedef struct
+{
+    Filter filter;
+    int width;
+    int height;
+    double apply_ms;
+    uint8_t persistence[VM_DISPLAY_HEIGHT * VM_DISPLAY_WIDTH];
+    uint32_t pixels[VM_DISPLAY_HEIGHT * FILTER_MAX_SCALE * VM_DISPLAY_WIDTH * FILTER_MAX_SCALE];
+} FilterState;
+
+FilterState *filter_state_new(Filter filter);
+void filter_state_free(FilterState *state);
+void filter_apply(FilterState *state, const Display *display);
+void filter_expand_bits(const uint64_t *bits, int count, uint32_t *out, uint32_t on, uint32_t off);
+
+int filter_from_cstr(const char *name, Filter *filter);
+const char *filter_to_cstr(Filter filter);
@@ -0,0 +1,106 @@
+#include "FramePacer.h"
+
+#include <math.h>
+
+#include "../Util/Clock.h"
+
+// Sleep until just before the deadline and spin the rest, which bounds the
+// busy wait to a fraction of a millisecond per frame
+#define FRAME_PACER_SPIN_MS 0.25
+#define FRAME_PACER_VSYNC_CHECK_FRAMES 30
+
+const char *pacing_mode_to_cstr(PacingMode mode)
+{
+    switch (mode)
+    {
+    case PACING_VSYNC:
+        return "vsync";
+    case PACING_TIMED:
+        return "timed";
+    default:
+        return "pacing_mode_to_cstr unknown mode";
+    }
+}
+
+double frame_pacer_now_ms(void)
+{
+    return (double)SDL_GetPerformanceCounter() * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+void frame_pacer_init(FramePacer *pacer, RenderContext *context, double fps)
+{
+    pacer->frame_ms = 1000.0 / fps;
+    pacer->mode = PACING_TIMED;
+    pacer->frames = 0;
+    histogram_reset(&pacer->jitter);
+
+    if (context->vsync)
+    {
+        SDL_DisplayMode mode;
+        int display = SDL_GetWindowDisplayIndex(context->window);
+        if (display >= 0 && SDL_GetCurrentDisplayMode(display, &mode) == 0 && fabs((double)mode.refresh_rate - fps) <= 2.0)
+        {
+            pacer->mode = PACING_VSYNC;
+        }
+    }
+
+    pacer->last_present_ms = frame_pacer_now_ms();
+    pacer->next_frame_ms = pacer->last_present_ms + pacer->frame_ms;
+    pacer->vsync_check_start_ms = pacer->last_present_ms;
+}
+
+static void frame_pacer_wait(FramePacer *pacer)
+{
+    double now = frame_pacer_now_ms();
+    double remaining = pacer->next_frame_ms - now;
+
+    if (remaining > FRAME_PACER_SPIN_MS)
+    {
+        clock_sleep_ms(remaining - FRAME_PACER_SPIN_MS);
+    }
+
+    while (frame_pacer_now_ms() < pacer->next_frame_ms)
+    {
+    }
+
+    pacer->next_frame_ms += pacer->frame_ms;
+
+    // Don't try to catch up after a stall, that would present a burst of frames
+    now = frame_pacer_now_ms();
+    if (pacer->next_frame_ms < now)
+    {
+        pacer->next_frame_ms = now + pacer->frame_ms;
+    }
+}
+
+void frame_pacer_present(FramePacer *pacer, RenderContext *context)
+{
+    if (pacer->mode == PACING_TIMED)
+    {
+        frame_pacer_wait(pacer);
+    }
+
+    SDL_RenderPresent(context->renderer);
+
+    double now = frame_pacer_now_ms();
+    double interval = now - pacer->last_present_ms;
+    pacer->last_present_ms = now;
+    pacer->frames++;
+
+    if (pacer->frames > 1)
+    {
+        histogram_record(&pacer->jitter, fabs(interval - pacer->frame_ms));
+    }
+
+    // Some drivers accept the vsync flag but never block, fall back to sleeping if presents come back too fast
+    if (pacer->mode == PACING_VSYNC && pacer->frames == FRAME_PACER_VSYNC_CHECK_FRAMES)
+    {
+        double average = (now - pacer->vsync_check_start_ms) / FRAME_PACER_VSYNC_CHECK_FRAMES;
+        if (average < pacer->frame_ms * 0.75)
+        {
+            fprintf(stderr, "WARNING: vsync is not blocking, falling back to timed frame pacing\n");
+            pacer->mode = PACING_TIMED;
+            pacer->next_frame_ms = now + pacer->frame_ms;
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "RenderContext.h"
+#include "../Util/Histogram.h"
+
+typedef enum PacingMode
+{
+    PACING_VSYNC = 0,
+    PACING_TIMED
+} PacingMode;
+
+// Presents exactly once per emulated frame. Uses the display's vsync when it
+// runs at the emulated frame rate, otherwise sleeps until the next deadline.
+typedef struct
+{
+    PacingMode mode;
+    double frame_ms;
+    double next_frame_ms;
+    double last_present_ms;
+    uint64_t frames;
+    double vsync_check_start_ms;
+    Histogram jitter;
+} FramePacer;
+
+void frame_pacer_init(FramePacer *pacer, RenderContext *context, double fps);
+void frame_pacer_present(FramePacer *pacer, RenderContext *context);
+double frame_pacer_now_ms(void);
+const char *pacing_mode_to_cstr(PacingMode mode);
@@ -1,6 +1,6 @@
 #include "RenderContext.h"
 
-int init_render_context(RenderContext *context)
+int init_render_context(RenderContext *context, bool vsync)
 {
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0)
     {
@@ -16,7 +16,7 @@ int init_render_context(RenderContext *context)
         return 1;
     }
 
-    context->renderer = SDL_CreateRenderer(context->window, -1, 0);
+    context->renderer = SDL_CreateRenderer(context->window, -1, vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
 
     if (!context->renderer)
     {
@@ -24,11 +24,20 @@ int init_render_context(RenderContext *context)
         return 1;
     }
 
+    SDL_RendererInfo info;
+    context->vsync = SDL_GetRendererInfo(context->renderer, &info) == 0 && (info.flags & SDL_RENDERER_PRESENTVSYNC);
+
     return 0;
 }
 
 void dispose_render_context(RenderContext *context)
 {
+    if (context->texture != NULL)
+    {
+        SDL_DestroyTexture(context->texture);
+        context->texture = NULL;
+    }
+
     if (context->renderer != NULL)
     {
         SDL_DestroyRenderer(context->renderer);
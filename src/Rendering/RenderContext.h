@@ -1,14 +1,19 @@
 #pragma once
 
 #include "SDL2/SDL.h"
+#include <stdbool.h>
 #include <stdio.h>
 
 typedef struct
 {
     SDL_Window *window;
     SDL_Renderer *renderer;
+    SDL_Texture *texture;
+    int texture_width;
+    int texture_height;
+    bool vsync;
 
 } RenderContext;
 
-int init_render_context(RenderContext *context);
+int init_render_context(RenderContext *context, bool vsync);
 void dispose_render_context(RenderContext *context);
\ No newline at end of file
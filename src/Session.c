@@ -0,0 +1,199 @@
+#include "Session.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "Data/Font.h"
+#include "Conformance/Conformance.h"
+#include "Headless.h"
+#include "Library/RomLibrary.h"
+
+// Runs the modes that only print a report: the conformance suite and the
+// library listing. Returns SESSION_NOT_BATCH when options ask for a ROM to run
+int session_run_batch(const Options *options, size_t cpu_count)
+{
+    if (options->conformance_manifest != NULL)
+    {
+        size_t threads = options->threads > 0 ? options->threads : cpu_count;
+        return conformance_run(options->conformance_manifest, options->ips, threads, options->tolerance, options->update_golden);
+    }
+
+    if (options->library_path != NULL && options->rom_count == 0)
+    {
+        RomLibrary *library = rom_library_open(options->library_path);
+        if (library == NULL)
+        {
+            return 1;
+        }
+        rom_library_print(library, stdout);
+        rom_library_free(library);
+        return 0;
+    }
+
+    return SESSION_NOT_BATCH;
+}
+
+static int session_load_library_program(VM *vm, Options *options)
+{
+    RomLibrary *library = rom_library_open(options->library_path);
+    if (library == NULL)
+    {
+        return 1;
+    }
+
+    const RomEntry *entry = rom_library_find(library, options->rom_path);
+    RomImage image;
+    if (entry == NULL || rom_image_map(&image, library, entry) != 0)
+    {
+        rom_library_free(library);
+        return 1;
+    }
+
+    printf("Loading program %s (%016" PRIx64 ")\n", rom_library_path(library, entry), entry->hash);
+
+    if (entry->recommended_ips == ROM_UNSUPPORTED_IPS)
+    {
+        fprintf(stderr, "WARNING: %s uses instructions this interpreter doesn't implement and won't run correctly\n", rom_library_path(library, entry));
+    }
+    // The library's hint is only a default, --ips still wins
+    else if (!options->custom_ips)
+    {
+        options->ips = entry->recommended_ips;
+    }
+
+    int result = vm_load_program_memory(vm, image.data, image.size);
+    rom_image_unmap(&image);
+    rom_library_free(library);
+    return result;
+}
+
+static void session_release_vm(Session *session)
+{
+    if (session->shared != NULL)
+    {
+        shared_state_destroy(session->shared, session->shm_name);
+    }
+    else
+    {
+        vm_free(session->vm);
+    }
+    session->vm = NULL;
+    session->shared = NULL;
+}
+
+// Creates the VM (inside the shared memory segment with --shm), loads the ROM
+// and opens capture, streaming and the debugger as requested
+int session_open(Session *session, Options *options)
+{
+    memset(session, 0, sizeof(Session));
+    session->shm_name = options->shm_name;
+
+    if (options->shm_name != NULL)
+    {
+        session->shared = shared_state_create(options->shm_name);
+        if (session->shared == NULL)
+        {
+            return 1;
+        }
+        session->vm = &session->shared->vm;
+    }
+    else
+    {
+        session->vm = vm_new();
+        if (session->vm == NULL)
+        {
+            return 1;
+        }
+    }
+
+    VM *vm = session->vm;
+    vm_seed_random(vm, (uint32_t)time(NULL));
+    vm_memcpy(vm, 0x0, (void *)FONT_DATA, FONT_DATA_SIZE);
+
+    int load_error;
+    if (options->library_path != NULL)
+    {
+        load_error = session_load_library_program(vm, options);
+    }
+    else
+    {
+        printf("Loading program %s\n", options->rom_path);
+        load_error = vm_load_program(vm, options->rom_path);
+    }
+
+    if (load_error != 0)
+    {
+        session_release_vm(session);
+        return 1;
+    }
+
+    vm->program_counter = 0x200;
+
+    if (options->capture_path != NULL)
+    {
+        session->capture = capture_open(options->capture_path, options->capture_format, options->headless);
+        if (session->capture == NULL)
+        {
+            session_release_vm(session);
+            return 1;
+        }
+    }
+
+    if (options->serve_address != NULL)
+    {
+        session->stream = stream_server_open(options->serve_address);
+        if (session->stream == NULL)
+        {
+            session_close(session);
+            return 1;
+        }
+    }
+
+    if (options->debug)
+    {
+        session->debugger = &session->debugger_state;
+        session->debugger->paused = true;
+        snprintf(session->debugger->reason, sizeof(session->debugger->reason), "program start");
+    }
+
+    return 0;
+}
+
+// Returns non-zero if the capture couldn't be finished
+int session_close(Session *session)
+{
+    int status = capture_close(session->capture);
+    stream_server_close(session->stream);
+    session_release_vm(session);
+    session->capture = NULL;
+    session->stream = NULL;
+    return status;
+}
+
+int session_run_headless(Session *session, const Options *options)
+{
+    HeadlessConfig config = {
+        .frames = options->frames,
+        .ips = options->ips,
+        .capture = session->capture,
+        .shared = session->shared,
+        .stream = session->stream,
+        .debugger = session->debugger,
+    };
+    HeadlessResult result;
+    int status = headless_run(session->vm, &config, &result);
+    if (result.error != VMERROR_OK)
+    {
+        fprintf(stderr, "ERROR: %s\n", vmerror_to_cstr(result.error));
+    }
+
+    printf("Ran %llu frames, %llu instructions in %.3fms (%.0f IPS)\n",
+           (unsigned long long)result.frames,
+           (unsigned long long)result.instructions,
+           result.elapsed_ms,
+           result.elapsed_ms > 0 ? (double)result.instructions * 1000.0 / result.elapsed_ms : 0.0);
+
+    return status;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "Options.h"
+#include "VM/VM.h"
+#include "Capture/Capture.h"
+#include "Share/SharedState.h"
+#include "Stream/StreamServer.h"
+#include "Debugger/Debugger.h"
+
+#define SESSION_NOT_BATCH -1
+
+// Everything running one ROM needs besides a window, shared by the SDL
+// frontend and chip8-headless. Must not move once opened, debugger may point
+// into it.
+typedef struct
+{
+    VM *vm;
+    SharedState *shared;
+    const char *shm_name;
+    Capture *capture;
+    StreamServer *stream;
+    Debugger debugger_state;
+    Debugger *debugger;
+} Session;
+
+int session_run_batch(const Options *options, size_t cpu_count);
+int session_open(Session *session, Options *options);
+int session_close(Session *session);
+int session_run_headless(Session *session, const Options *options);
@@ -0,0 +1,238 @@
+#include "SharedState.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define SHARED_STATE_READ_ATTEMPTS 100000
+#define SHARED_STATE_SPINS_BEFORE_YIELD 64
+
+#ifdef _WIN32
+
+SharedState *shared_state_create(const char *name)
+{
+    (void)name;
+    fprintf(stderr, "ERROR: Shared memory export is not supported on this platform.\n");
+    return NULL;
+}
+
+void shared_state_destroy(SharedState *state, const char *name)
+{
+    (void)state;
+    (void)name;
+}
+
+const SharedState *shared_state_attach(const char *name)
+{
+    (void)name;
+    fprintf(stderr, "ERROR: Shared memory export is not supported on this platform.\n");
+    return NULL;
+}
+
+void shared_state_detach(const SharedState *state)
+{
+    (void)state;
+}
+
+#else
+
+// Unlinks a segment left behind by an instance that was killed. Returns non
+// zero if the segment under name belongs to a running instance or can't be
+// told apart from one
+static int shared_state_remove_stale(const char *name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return 0;
+    }
+
+    struct stat info;
+    const SharedState *state = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(SharedState))
+    {
+        state = mmap(NULL, sizeof(SharedState), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    // A segment that is still being set up has no magic yet either
+    if (state == MAP_FAILED || state->magic != SHARED_STATE_MAGIC || state->version != SHARED_STATE_VERSION)
+    {
+        if (state != MAP_FAILED)
+        {
+            munmap((void *)state, sizeof(SharedState));
+        }
+        fprintf(stderr, "ERROR: Shared memory segment %s exists but wasn't created by this version, remove it if no instance uses it.\n", name);
+        return 1;
+    }
+
+    pid_t owner = (pid_t)state->owner_pid;
+    munmap((void *)state, sizeof(SharedState));
+
+    if (kill(owner, 0) == 0 || errno == EPERM)
+    {
+        fprintf(stderr, "ERROR: Shared memory segment %s is in use by process %d.\n", name, (int)owner);
+        return 1;
+    }
+
+    if (shm_unlink(name) != 0 && errno != ENOENT)
+    {
+        fprintf(stderr, "ERROR: Unable to remove stale shared memory segment %s: %s.\n", name, strerror(errno));
+        return 1;
+    }
+    fprintf(stderr, "WARNING: Removed stale shared memory segment %s of process %d.\n", name, (int)owner);
+    return 0;
+}
+
+SharedState *shared_state_create(const char *name)
+{
+    if (shared_state_remove_stale(name) != 0)
+    {
+        return NULL;
+    }
+
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        fprintf(stderr, "ERROR: Unable to create shared memory segment %s: %s.\n", name, strerror(errno));
+        return NULL;
+    }
+
+    if (ftruncate(fd, sizeof(SharedState)) != 0)
+    {
+        fprintf(stderr, "ERROR: Unable to size shared memory segment %s: %s.\n", name, strerror(errno));
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+
+    // The segment is zero filled, which is exactly what vm_new would give us
+    SharedState *state = mmap(NULL, sizeof(SharedState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (state == MAP_FAILED)
+    {
+        fprintf(stderr, "ERROR: Unable to map shared memory segment %s: %s.\n", name, strerror(errno));
+        shm_unlink(name);
+        return NULL;
+    }
+
+    state->version = SHARED_STATE_VERSION;
+    state->vm_size = sizeof(VM);
+    state->owner_pid = (uint32_t)getpid();
+    atomic_store_explicit(&state->sequence, 0, memory_order_relaxed);
+    atomic_store_explicit(&state->frame, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    state->magic = SHARED_STATE_MAGIC;
+
+    return state;
+}
+
+void shared_state_destroy(SharedState *state, const char *name)
+{
+    if (state != NULL)
+    {
+        munmap(state, sizeof(SharedState));
+        shm_unlink(name);
+    }
+}
+
+const SharedState *shared_state_attach(const char *name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        fprintf(stderr, "ERROR: Unable to open shared memory segment %s: %s.\n", name, strerror(errno));
+        return NULL;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(SharedState))
+    {
+        fprintf(stderr, "ERROR: Shared memory segment %s is too small.\n", name);
+        close(fd);
+        return NULL;
+    }
+
+    const SharedState *state = mmap(NULL, sizeof(SharedState), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (state == MAP_FAILED)
+    {
+        fprintf(stderr, "ERROR: Unable to map shared memory segment %s: %s.\n", name, strerror(errno));
+        return NULL;
+    }
+
+    if (state->magic != SHARED_STATE_MAGIC || state->version != SHARED_STATE_VERSION || state->vm_size != sizeof(VM))
+    {
+        fprintf(stderr, "ERROR: Shared memory segment %s has an incompatible layout.\n", name);
+        munmap((void *)state, sizeof(SharedState));
+        return NULL;
+    }
+
+    return state;
+}
+
+void shared_state_detach(const SharedState *state)
+{
+    if (state != NULL)
+    {
+        munmap((void *)state, sizeof(SharedState));
+    }
+}
+
+#endif
+
+void shared_state_begin_write(SharedState *state)
+{
+    uint32_t sequence = atomic_load_explicit(&state->sequence, memory_order_relaxed);
+    atomic_store_explicit(&state->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+void shared_state_end_write(SharedState *state)
+{
+    uint32_t sequence = atomic_load_explicit(&state->sequence, memory_order_relaxed);
+    atomic_fetch_add_explicit(&state->frame, 1, memory_order_relaxed);
+    atomic_store_explicit(&state->sequence, sequence + 1, memory_order_release);
+}
+
+// Copies a consistent snapshot, retrying while the emulator is in the middle of a frame
+bool shared_state_read(const SharedState *state, SharedSnapshot *snapshot)
+{
+    for (int attempt = 0; attempt < SHARED_STATE_READ_ATTEMPTS; attempt++)
+    {
+#ifndef _WIN32
+        // The emulator may have been preempted mid frame, give it the CPU back
+        if (attempt > 0 && attempt % SHARED_STATE_SPINS_BEFORE_YIELD == 0)
+        {
+            sched_yield();
+        }
+#endif
+
+        uint32_t before = atomic_load_explicit((_Atomic uint32_t *)&state->sequence, memory_order_acquire);
+        if (before & 1)
+        {
+            continue;
+        }
+
+        snapshot->frame = atomic_load_explicit((_Atomic uint64_t *)&state->frame, memory_order_relaxed);
+        memcpy(&snapshot->vm, (const void *)&state->vm, sizeof(VM));
+
+        atomic_thread_fence(memory_order_acquire);
+        uint32_t after = atomic_load_explicit((_Atomic uint32_t *)&state->sequence, memory_order_relaxed);
+        if (before == after)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../VM/VM.h"
+
+#define SHARED_STATE_MAGIC 0x38504843
+#define SHARED_STATE_VERSION 3
+
+// Layout of the shared memory segment. The running VM lives directly inside
+// it, so exporting costs the emulator two stores per frame: the sequence
+// counter is odd while a frame is being emulated and even once it is done.
+// owner_pid tells a new instance whether a segment under its name is stale.
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vm_size;
+    uint32_t owner_pid;
+    _Atomic uint32_t sequence;
+    _Atomic uint64_t frame;
+    VM vm;
+} SharedState;
+
+typedef struct
+{
+    uint64_t frame;
+    VM vm;
+} SharedSnapshot;
+
+SharedState *shared_state_create(const char *name);
+void shared_state_destroy(SharedState *state, const char *name);
+
+const SharedState *shared_state_attach(const char *name);
+void shared_state_detach(const SharedState *state);
+
+void shared_state_begin_write(SharedState *state);
+void shared_state_end_write(SharedState *state);
+bool shared_state_read(const SharedState *state, SharedSnapshot *snapshot);
@@ -0,0 +1,340 @@
+#include "StreamProtocol.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#define STREAM_LISTEN_BACKLOG 16
+
+static void stream_put_u32(uint8_t *out, uint32_t value)
+{
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    out[2] = (uint8_t)(value >> 16);
+    out[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t stream_get_u32(const uint8_t *data)
+{
+    return (uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+// PackBits: a control byte below 128 is followed by that many plus one literal
+// bytes, a control byte above 128 repeats the next byte 257 minus control times
+static size_t stream_rle_encode(const uint8_t *data, size_t length, uint8_t *out)
+{
+    size_t written = 0;
+    size_t i = 0;
+
+    while (i < length)
+    {
+        size_t run = 1;
+        while (i + run < length && run < 128 && data[i + run] == data[i])
+        {
+            run++;
+        }
+
+        if (run >= 3)
+        {
+            out[written++] = (uint8_t)(257 - run);
+            out[written++] = data[i];
+            i += run;
+            continue;
+        }
+
+        size_t start = i;
+        size_t literal = 0;
+        while (i < length && literal < 128)
+        {
+            if (i + 2 < length && data[i] == data[i + 1] && data[i] == data[i + 2])
+            {
+                break;
+            }
+            i++;
+            literal++;
+        }
+
+        out[written++] = (uint8_t)(literal - 1);
+        memcpy(&out[written], &data[start], literal);
+        written += literal;
+    }
+
+    return written;
+}
+
+static int stream_rle_decode(const uint8_t *data, size_t length, uint8_t *out, size_t capacity)
+{
+    size_t written = 0;
+    size_t i = 0;
+
+    while (i < length)
+    {
+        uint8_t control = data[i++];
+        if (control < 128)
+        {
+            size_t literal = (size_t)control + 1;
+            if (i + literal > length || written + literal > capacity)
+            {
+                return -1;
+            }
+            memcpy(&out[written], &data[i], literal);
+            written += literal;
+            i += literal;
+        }
+        else if (control > 128)
+        {
+            size_t run = 257 - (size_t)control;
+            if (i >= length || written + run > capacity)
+            {
+                return -1;
+            }
+            memset(&out[written], data[i++], run);
+            written += run;
+        }
+    }
+
+    return (int)written;
+}
+
+size_t stream_encode_delta(const uint64_t base[VM_DISPLAY_HEIGHT], const uint64_t rows[VM_DISPLAY_HEIGHT], uint32_t frame, uint8_t *out)
+{
+    uint8_t changes[VM_DISPLAY_HEIGHT * STREAM_ROW_BYTES];
+    size_t changes_length = 0;
+    uint32_t row_mask = 0;
+
+    for (int y = 0; y < VM_DISPLAY_HEIGHT; y++)
+    {
+        uint64_t delta = base[y] ^ rows[y];
+        if (delta == 0)
+        {
+            continue;
+        }
+
+        row_mask |= 1u << y;
+        for (int i = 0; i < STREAM_ROW_BYTES; i++)
+        {
+            changes[changes_length++] = (uint8_t)(delta >> (i * 8));
+        }
+    }
+
+    size_t length = stream_rle_encode(changes, changes_length, &out[STREAM_HEADER_SIZE]);
+
+    stream_put_u32(&out[0], STREAM_MAGIC);
+    stream_put_u32(&out[4], frame);
+    stream_put_u32(&out[8], row_mask);
+    out[12] = (uint8_t)length;
+    out[13] = (uint8_t)(length >> 8);
+    out[14] = 0;
+    out[15] = 0;
+
+    return STREAM_HEADER_SIZE + length;
+}
+
+int stream_decode_header(const uint8_t *data, StreamHeader *header)
+{
+    if (stream_get_u32(&data[0]) != STREAM_MAGIC)
+    {
+        return 1;
+    }
+
+    header->frame = stream_get_u32(&data[4]);
+    header->row_mask = stream_get_u32(&data[8]);
+    header->length = (uint16_t)(data[12] | data[13] << 8);
+
+    return header->length > STREAM_PAYLOAD_MAX;
+}
+
+int stream_apply_delta(const StreamHeader *header, const uint8_t *payload, uint64_t rows[VM_DISPLAY_HEIGHT])
+{
+    uint8_t changes[VM_DISPLAY_HEIGHT * STREAM_ROW_BYTES];
+    int length = stream_rle_decode(payload, header->length, changes, sizeof(changes));
+
+    int changed_rows = __builtin_popcount(header->row_mask);
+    if (length != changed_rows * STREAM_ROW_BYTES)
+    {
+        return 1;
+    }
+
+    const uint8_t *change = changes;
+    for (int y = 0; y < VM_DISPLAY_HEIGHT; y++)
+    {
+        if (!(header->row_mask & (1u << y)))
+        {
+            continue;
+        }
+
+        uint64_t delta = 0;
+        for (int i = 0; i < STREAM_ROW_BYTES; i++)
+        {
+            delta |= (uint64_t)change[i] << (i * 8);
+        }
+        rows[y] ^= delta;
+        change += STREAM_ROW_BYTES;
+    }
+
+    return 0;
+}
+
+#ifdef _WIN32
+
+int stream_socket_open(const char *address, bool listening)
+{
+    (void)address;
+    (void)listening;
+    fprintf(stderr, "ERROR: Streaming is not supported on this platform.\n");
+    return -1;
+}
+
+#else
+
+static int stream_unix_socket_open(const char *path, bool listening)
+{
+    struct sockaddr_un socket_address = {0};
+    socket_address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(socket_address.sun_path))
+    {
+        fprintf(stderr, "ERROR: Socket path %s is too long.\n", path);
+        return -1;
+    }
+    strcpy(socket_address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        fprintf(stderr, "ERROR: Unable to create socket.\n");
+        return -1;
+    }
+
+    if (listening)
+    {
+        // Replace a socket left behind by a previous run, but never a live one or any other kind of file
+        struct stat info;
+        if (stat(path, &info) == 0 && S_ISSOCK(info.st_mode))
+        {
+            int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+            int connected = probe >= 0 ? connect(probe, (struct sockaddr *)&socket_address, sizeof(socket_address)) : -1;
+            int error = errno;
+            if (probe >= 0)
+            {
+                close(probe);
+            }
+
+            if (connected == 0)
+            {
+                fprintf(stderr, "ERROR: Unable to listen on %s, address in use.\n", path);
+                close(fd);
+                return -1;
+            }
+            if (error != ECONNREFUSED)
+            {
+                fprintf(stderr, "ERROR: Unable to check socket %s: %s.\n", path, strerror(error));
+                close(fd);
+                return -1;
+            }
+            unlink(path);
+        }
+
+        if (bind(fd, (struct sockaddr *)&socket_address, sizeof(socket_address)) != 0 || listen(fd, STREAM_LISTEN_BACKLOG) != 0)
+        {
+            fprintf(stderr, "ERROR: Unable to listen on %s.\n", path);
+            close(fd);
+            return -1;
+        }
+    }
+    else if (connect(fd, (struct sockaddr *)&socket_address, sizeof(socket_address)) != 0)
+    {
+        fprintf(stderr, "ERROR: Unable to connect to %s.\n", path);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int stream_tcp_socket_open(const char *address, bool listening)
+{
+    char host[256];
+    const char *separator = strrchr(address, ':');
+    if (separator == NULL || (size_t)(separator - address) >= sizeof(host))
+    {
+        fprintf(stderr, "ERROR: Expected host:port, got %s.\n", address);
+        return -1;
+    }
+    memcpy(host, address, (size_t)(separator - address));
+    host[separator - address] = '\0';
+
+    struct addrinfo hints = {0};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+
+    struct addrinfo *addresses = NULL;
+    if (getaddrinfo(host[0] != '\0' ? host : NULL, separator + 1, &hints, &addresses) != 0)
+    {
+        fprintf(stderr, "ERROR: Unable to resolve %s.\n", address);
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *candidate = addresses; candidate != NULL; candidate = candidate->ai_next)
+    {
+        fd = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        if (listening)
+        {
+            int reuse = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            if (bind(fd, candidate->ai_addr, candidate->ai_addrlen) == 0 && listen(fd, STREAM_LISTEN_BACKLOG) == 0)
+            {
+                break;
+            }
+        }
+        else if (connect(fd, candidate->ai_addr, candidate->ai_addrlen) == 0)
+        {
+            break;
+        }
+
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(addresses);
+
+    if (fd < 0)
+    {
+        fprintf(stderr, "ERROR: Unable to %s %s.\n", listening ? "listen on" : "connect to", address);
+    }
+    return fd;
+}
+
+// Addresses are either unix:/path/to/socket or tcp:host:port
+int stream_socket_open(const char *address, bool listening)
+{
+    if (strncmp(address, "unix:", 5) == 0)
+    {
+        return stream_unix_socket_open(address + 5, listening);
+    }
+
+    if (strncmp(address, "tcp:", 4) == 0)
+    {
+        return stream_tcp_socket_open(address + 4, listening);
+    }
+
+    fprintf(stderr, "ERROR: Unknown stream address %s, expected unix:PATH or tcp:HOST:PORT.\n", address);
+    return -1;
+}
+
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../VM/Display.h"
+
+// Every message is a 16 byte little endian header followed by a payload:
+//
+//   uint32 magic       STREAM_MAGIC
+//   uint32 frame       emulated frame the message brings the viewer up to
+//   uint32 row_mask    bit y set when row y changed
+//   uint16 length      payload length in bytes
+//   uint16 reserved
+//
+// The payload is the PackBits encoded XOR of each changed row against the
+// previous frame the viewer received, 8 bytes per row with pixel x in bit x.
+// Viewers start from a blank screen.
+
+#define STREAM_MAGIC 0x44533843
+#define STREAM_HEADER_SIZE 16
+#define STREAM_ROW_BYTES 8
+#define STREAM_PAYLOAD_MAX (VM_DISPLAY_HEIGHT * STREAM_ROW_BYTES + VM_DISPLAY_HEIGHT * STREAM_ROW_BYTES / 128 + 1)
+#define STREAM_MESSAGE_MAX (STREAM_HEADER_SIZE + STREAM_PAYLOAD_MAX)
+
+typedef struct
+{
+    uint32_t frame;
+    uint32_t row_mask;
+    uint16_t length;
+} StreamHeader;
+
+size_t stream_encode_delta(const uint64_t base[VM_DISPLAY_HEIGHT], const uint64_t rows[VM_DISPLAY_HEIGHT], uint32_t frame, uint8_t *out);
+int stream_decode_header(const uint8_t *data, StreamHeader *header);
+int stream_apply_delta(const StreamHeader *header, const uint8_t *payload, uint64_t rows[VM_DISPLAY_HEIGHT]);
+
+int stream_socket_open(const char *address, bool listening);
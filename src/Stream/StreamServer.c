@@ -0,0 +1,194 @@
+#include "StreamServer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Util/Clock.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+StreamServer *stream_server_open(const char *address)
+{
+    stream_socket_open(address, true);
+    return NULL;
+}
+
+void stream_server_broadcast(StreamServer *server, const Display *display)
+{
+    (void)server;
+    (void)display;
+}
+
+void stream_server_close(StreamServer *server)
+{
+    (void)server;
+}
+
+#else
+
+#ifdef MSG_NOSIGNAL
+#define STREAM_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define STREAM_SEND_FLAGS 0
+#endif
+
+static void stream_client_disconnect(StreamServer *server, size_t index)
+{
+    close(server->clients[index].fd);
+    server->clients[index] = server->clients[--server->client_count];
+    printf("Stream viewer detached (%zu watching)\n", server->client_count);
+}
+
+static void stream_server_accept(StreamServer *server)
+{
+    // Headless runs produce frames far faster than viewers attach, don't pay a syscall for each one
+    double now = clock_now_ms();
+    if (now - server->last_accept_ms < STREAM_ACCEPT_INTERVAL_MS)
+    {
+        return;
+    }
+    server->last_accept_ms = now;
+
+    for (;;)
+    {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0)
+        {
+            return;
+        }
+
+        if (server->client_count >= STREAM_MAX_CLIENTS)
+        {
+            close(fd);
+            continue;
+        }
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+        int no_sigpipe = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe, sizeof(no_sigpipe));
+#endif
+
+        StreamClient *client = &server->clients[server->client_count++];
+        memset(client, 0, sizeof(StreamClient));
+        client->fd = fd;
+        printf("Stream viewer attached (%zu watching)\n", server->client_count);
+    }
+}
+
+// Returns non zero when the client is gone
+static int stream_client_flush(StreamClient *client)
+{
+    while (client->queue_offset < client->queue_length)
+    {
+        ssize_t sent = send(client->fd, &client->queue[client->queue_offset], client->queue_length - client->queue_offset, STREAM_SEND_FLAGS);
+        if (sent < 0)
+        {
+            return errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR;
+        }
+        client->queue_offset += (size_t)sent;
+    }
+
+    client->queue_length = 0;
+    client->queue_offset = 0;
+    return 0;
+}
+
+StreamServer *stream_server_open(const char *address)
+{
+    int fd = stream_socket_open(address, true);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    StreamServer *server = calloc(1, sizeof(StreamServer));
+    if (server == NULL)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    server->listen_fd = fd;
+    server->address = address;
+    printf("Streaming display on %s\n", address);
+    return server;
+}
+
+void stream_server_broadcast(StreamServer *server, const Display *display)
+{
+    stream_server_accept(server);
+    server->frame++;
+
+    if (server->client_count == 0)
+    {
+        return;
+    }
+
+    uint64_t rows[VM_DISPLAY_HEIGHT];
+    display_pack_rows(display, rows);
+
+    size_t i = 0;
+    while (i < server->client_count)
+    {
+        StreamClient *client = &server->clients[i];
+
+        if (stream_client_flush(client) != 0)
+        {
+            stream_client_disconnect(server, i);
+            continue;
+        }
+
+        if (client->queue_length > 0)
+        {
+            client->frames_dropped++;
+            i++;
+            continue;
+        }
+
+        if (memcmp(client->base, rows, sizeof(rows)) != 0)
+        {
+            client->queue_length = stream_encode_delta(client->base, rows, server->frame, client->queue);
+            memcpy(client->base, rows, sizeof(rows));
+
+            if (stream_client_flush(client) != 0)
+            {
+                stream_client_disconnect(server, i);
+                continue;
+            }
+        }
+
+        i++;
+    }
+}
+
+void stream_server_close(StreamServer *server)
+{
+    if (server == NULL)
+    {
+        return;
+    }
+
+    while (server->client_count > 0)
+    {
+        stream_client_disconnect(server, server->client_count - 1);
+    }
+
+    close(server->listen_fd);
+    if (strncmp(server->address, "unix:", 5) == 0)
+    {
+        unlink(server->address + 5);
+    }
+    free(server);
+}
+
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "StreamProtocol.h"
+
+#define STREAM_MAX_CLIENTS 64
+#define STREAM_ACCEPT_INTERVAL_MS 10.0
+
+// Each viewer has its own send queue holding at most one message. A viewer
+// whose previous message hasn't drained yet simply skips frames, and its next
+// delta is taken against the last frame it was actually sent, so slow viewers
+// never stall the emulator and never desynchronise.
+typedef struct
+{
+    int fd;
+    uint64_t base[VM_DISPLAY_HEIGHT];
+    uint8_t queue[STREAM_MESSAGE_MAX];
+    size_t queue_length;
+    size_t queue_offset;
+    uint64_t frames_dropped;
+} StreamClient;
+
+typedef struct
+{
+    int listen_fd;
+    const char *address;
+    StreamClient clients[STREAM_MAX_CLIENTS];
+    size_t client_count;
+    uint32_t frame;
+    double last_accept_ms;
+} StreamServer;
+
+StreamServer *stream_server_open(const char *address);
+void stream_server_broadcast(StreamServer *server, const Display *display);
+void stream_server_close(StreamServer *server);
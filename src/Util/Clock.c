@@ -0,0 +1,37 @@
+#include "Clock.h"
+
+#include <errno.h>
+#include <time.h>
+
+// Monotonic time in milliseconds, for code that must not depend on SDL
+double clock_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+// CPU time of the calling thread, unaffected by other threads sharing the core
+double clock_thread_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+// Sleeps with the OS timer's resolution (well below a millisecond on Linux)
+// rather than SDL_Delay's whole milliseconds
+void clock_sleep_ms(double ms)
+{
+    if (ms <= 0)
+    {
+        return;
+    }
+
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ms / 1000.0);
+    ts.tv_nsec = (long)((ms - (double)ts.tv_sec * 1000.0) * 1000000.0);
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+    {
+    }
+}
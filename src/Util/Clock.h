@@ -0,0 +1,5 @@
+#pragma once
+
+double clock_now_ms(void);
+double clock_thread_ms(void);
+void clock_sleep_ms(double ms);
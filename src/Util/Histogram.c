@@ -0,0 +1,81 @@
+#include "Histogram.h"
+
+#include <string.h>
+
+void histogram_reset(Histogram *histogram)
+{
+    memset(histogram, 0, sizeof(Histogram));
+}
+
+void histogram_record(Histogram *histogram, double ms)
+{
+    if (ms < 0)
+    {
+        ms = 0;
+    }
+
+    size_t bucket = (size_t)(ms / HISTOGRAM_BUCKET_MS);
+    if (bucket > HISTOGRAM_BUCKETS)
+    {
+        bucket = HISTOGRAM_BUCKETS;
+    }
+
+    if (histogram->count == 0 || ms < histogram->min)
+    {
+        histogram->min = ms;
+    }
+    if (ms > histogram->max)
+    {
+        histogram->max = ms;
+    }
+
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->sum += ms;
+}
+
+double histogram_percentile(const Histogram *histogram, double percentile)
+{
+    if (histogram->count == 0)
+    {
+        return 0;
+    }
+
+    uint64_t target = (uint64_t)((double)histogram->count * percentile / 100.0 + 0.5);
+    if (target < 1)
+    {
+        target = 1;
+    }
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i <= HISTOGRAM_BUCKETS; i++)
+    {
+        seen += histogram->buckets[i];
+        if (seen >= target)
+        {
+            // Report the upper edge of the bucket, but never more than what was actually recorded
+            double value = (double)(i + 1) * HISTOGRAM_BUCKET_MS;
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
+
+void histogram_print(const Histogram *histogram, const char *name, FILE *stream)
+{
+    if (histogram->count == 0)
+    {
+        fprintf(stream, "%s: no samples\n", name);
+        return;
+    }
+
+    fprintf(stream, "%s: n=%llu min=%.2fms avg=%.2fms p50=%.2fms p99=%.2fms max=%.2fms\n",
+            name,
+            (unsigned long long)histogram->count,
+            histogram->min,
+            histogram->sum / (double)histogram->count,
+            histogram_percentile(histogram, 50),
+            histogram_percentile(histogram, 99),
+            histogram->max);
+}
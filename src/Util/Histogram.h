@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define HISTOGRAM_BUCKETS 2000
+#define HISTOGRAM_BUCKET_MS 0.05
+
+// Fixed resolution histogram of millisecond samples, anything above
+// HISTOGRAM_BUCKETS * HISTOGRAM_BUCKET_MS lands in the last bucket.
+typedef struct
+{
+    uint32_t buckets[HISTOGRAM_BUCKETS + 1];
+    uint64_t count;
+    double sum;
+    double min;
+    double max;
+} Histogram;
+
+void histogram_reset(Histogram *histogram);
+void histogram_record(Histogram *histogram, double ms);
+double histogram_percentile(const Histogram *histogram, double percentile);
+void histogram_print(const Histogram *histogram, const char *name, FILE *stream);
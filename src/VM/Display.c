@@ -1,7 +1,19 @@
 #include "Display.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 void display_clear(Display *display)
 {
+    // Every lit pixel flips off
+    uint64_t rows[VM_DISPLAY_HEIGHT];
+    display_pack_rows(display, rows);
+    for (int y = 0; y < VM_DISPLAY_HEIGHT; y++)
+    {
+        display->changes[y] ^= rows[y];
+    }
+
     for (int x = 0; x < VM_DISPLAY_WIDTH; x++)
     {
         for (int y = 0; y < VM_DISPLAY_HEIGHT; y++)
@@ -9,4 +21,62 @@ void display_clear(Display *display)
             display->pixels[y][x] = 0;
         }
     }
+}
+
+// Ends a frame, marking the display dirty if it differs from the previous frame
+void display_commit(Display *display)
+{
+    uint64_t changed = 0;
+    for (int y = 0; y < VM_DISPLAY_HEIGHT; y++)
+    {
+        changed |= display->changes[y];
+        display->changes[y] = 0;
+    }
+
+    if (changed != 0)
+    {
+        display->dirty = true;
+    }
+}
+
+// Packs each row into a bit mask, bit x set when pixel x is lit
+void display_pack_rows(const Display *display, uint64_t rows[VM_DISPLAY_HEIGHT])
+{
+    for (int y = 0; y < VM_DISPLAY_HEIGHT; y++)
+    {
+        uint64_t row = 0;
+#ifdef __SSE2__
+        const __m128i zero = _mm_setzero_si128();
+        for (int x = 0; x < VM_DISPLAY_WIDTH; x += 16)
+        {
+            __m128i chunk = _mm_loadu_si128((const __m128i *)&display->pixels[y][x]);
+            uint64_t unlit = (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero));
+            row |= (~unlit & 0xFFFF) << x;
+        }
+#else
+        for (int x = 0; x < VM_DISPLAY_WIDTH; x++)
+        {
+            row |= (uint64_t)(display->pixels[y][x] != 0) << x;
+        }
+#endif
+        rows[y] = row;
+    }
+}
+
+// FNV-1a over the packed rows, stable across platforms and builds
+uint64_t display_hash(const Display *display)
+{
+    uint64_t rows[VM_DISPLAY_HEIGHT];
+    display_pack_rows(display, rows);
+
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (int y = 0; y < VM_DISPLAY_HEIGHT; y++)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            hash ^= (rows[y] >> (i * 8)) & 0xFF;
+            hash *= 0x100000001B3ULL;
+        }
+    }
+    return hash;
 }
\ No newline at end of file
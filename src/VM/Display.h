@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #define VM_DISPLAY_WIDTH 64
 #define VM_DISPLAY_HEIGHT 32
@@ -8,6 +9,14 @@
 typedef struct
 {
     bool pixels[VM_DISPLAY_HEIGHT][VM_DISPLAY_WIDTH];
+    // Pixels flipped since the last display_commit, one bit per pixel like
+    // display_pack_rows. Erasing and redrawing a sprite cancels out
+    uint64_t changes[VM_DISPLAY_HEIGHT];
+    // Set when a frame ends different from the previous one, cleared by whoever consumes the frame
+    bool dirty;
 } Display;
 
-void display_clear(Display *display);
\ No newline at end of file
+void display_clear(Display *display);
+void display_commit(Display *display);
+void display_pack_rows(const Display *display, uint64_t rows[VM_DISPLAY_HEIGHT]);
+uint64_t display_hash(const Display *display);
\ No newline at end of file
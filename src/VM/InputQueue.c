@@ -0,0 +1,79 @@
+#include "InputQueue.h"
+
+static InputEvent *input_queue_at(InputQueue *queue, size_t index)
+{
+    return &queue->events[(queue->head + index) % INPUT_QUEUE_CAPACITY];
+}
+
+static void input_queue_remove(InputQueue *queue, size_t index)
+{
+    for (size_t i = index; i + 1 < queue->count; i++)
+    {
+        *input_queue_at(queue, i) = *input_queue_at(queue, i + 1);
+    }
+    queue->count--;
+}
+
+// A full queue (the VM isn't consuming it, e.g. while the debugger is paused)
+// must never lose the last state of a key, or a dropped release leaves it stuck
+static void input_queue_make_room(InputQueue *queue, const InputEvent *event)
+{
+    // Fold into the newest event for the same key, which the new one supersedes
+    for (size_t i = queue->count; i-- > 0;)
+    {
+        InputEvent *queued = input_queue_at(queue, i);
+        if (queued->key == event->key)
+        {
+            input_queue_remove(queue, i);
+            return;
+        }
+    }
+
+    // Otherwise some other key has at least two events queued, drop the older of its newest two
+    for (size_t i = queue->count; i-- > 0;)
+    {
+        for (size_t j = i; j-- > 0;)
+        {
+            if (input_queue_at(queue, j)->key == input_queue_at(queue, i)->key)
+            {
+                input_queue_remove(queue, j);
+                return;
+            }
+        }
+    }
+}
+
+void input_queue_push(InputQueue *queue, InputEvent event)
+{
+    if (queue->count >= INPUT_QUEUE_CAPACITY)
+    {
+        input_queue_make_room(queue, &event);
+    }
+
+    if (queue->count > 0)
+    {
+        // Keep the queue ordered, an event can never be applied before one that happened earlier
+        const InputEvent *last = input_queue_at(queue, queue->count - 1);
+        if (event.cycle < last->cycle)
+        {
+            event.cycle = last->cycle;
+        }
+    }
+
+    *input_queue_at(queue, queue->count) = event;
+    queue->count++;
+}
+
+size_t input_queue_apply(InputQueue *queue, Keyboard *keyboard, uint64_t cycle)
+{
+    size_t applied = 0;
+    while (queue->count > 0 && queue->events[queue->head].cycle <= cycle)
+    {
+        InputEvent *event = &queue->events[queue->head];
+        keyboard->keys[event->key & 0x0F] = event->pressed;
+        queue->head = (queue->head + 1) % INPUT_QUEUE_CAPACITY;
+        queue->count--;
+        applied++;
+    }
+    return applied;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Keyboard.h"
+
+#define INPUT_QUEUE_CAPACITY 64
+
+typedef struct
+{
+    uint64_t cycle;
+    uint8_t key;
+    bool pressed;
+} InputEvent;
+
+// Key changes waiting to be applied to a Keyboard once the VM reaches the
+// emulated cycle they were stamped with. When full, events are coalesced so
+// the latest state of every key is always kept.
+typedef struct
+{
+    InputEvent events[INPUT_QUEUE_CAPACITY];
+    size_t head;
+    size_t count;
+} InputQueue;
+
+void input_queue_push(InputQueue *queue, InputEvent event);
+size_t input_queue_apply(InputQueue *queue, Keyboard *keyboard, uint64_t cycle);
@@ -1,6 +1,7 @@
 #include "Instructions.h"
 
 #include "stdint.h"
+#include <stdio.h>
 
 const char *opcode_to_cstr(uint16_t opcode)
 {
@@ -10,15 +11,195 @@ const char *opcode_to_cstr(uint16_t opcode)
         return "INST_CLEAR_SCREEN";
     case INST_JUMP:
         return "INST_JUMP";
+    case INST_SCALL:
+        return "INST_SCALL";
+    case INST_SKIP_EQ:
+        return "INST_SKIP_EQ";
+    case INST_SKIP_NOT_EQ:
+        return "INST_SKIP_NOT_EQ";
+    case INST_SKIP_V_EQ:
+        return "INST_SKIP_V_EQ";
     case INST_SETVX:
         return "INST_SETVX";
     case INST_ADDVX:
         return "INST_ADDVX";
+    case INST_MATH:
+        return "INST_MATH";
+    case INST_SKIP_V_NOT_EQ:
+        return "INST_SKIP_V_NOT_EQ";
     case INST_SETIR:
         return "INST_SETIR";
+    case INST_JUMP_OFFSET:
+        return "INST_JUMP_OFFSET";
+    case INST_RANDOM:
+        return "INST_RANDOM";
     case INST_DRAW:
         return "INST_DRAW";
+    case INST_SKIP_IF_KEY:
+        return "INST_SKIP_IF_KEY";
+    case INST_TIMER:
+        return "INST_TIMER";
     default:
         return "UNKNOWN OPCODE in opcode_to_cstr";
     }
-}
\ No newline at end of file
+}
+
+void instruction_disassemble(uint16_t instruction, char *out, size_t length)
+{
+    unsigned int X = (instruction & 0x0F00) >> 8;
+    unsigned int Y = (instruction & 0x00F0) >> 4;
+    unsigned int N = instruction & 0x000F;
+    unsigned int NN = instruction & 0x00FF;
+    unsigned int NNN = instruction & 0x0FFF;
+
+    switch (instruction & 0xF000)
+    {
+    case INST_CLEAR_SCREEN:
+        if (instruction == 0x00E0)
+        {
+            snprintf(out, length, "CLS");
+        }
+        else if (instruction == INST_SRET)
+        {
+            snprintf(out, length, "RET");
+        }
+        else
+        {
+            snprintf(out, length, "SYS  0x%03X", NNN);
+        }
+        return;
+    case INST_JUMP:
+        snprintf(out, length, "JP   0x%03X", NNN);
+        return;
+    case INST_SCALL:
+        snprintf(out, length, "CALL 0x%03X", NNN);
+        return;
+    case INST_SKIP_EQ:
+        snprintf(out, length, "SE   V%X, 0x%02X", X, NN);
+        return;
+    case INST_SKIP_NOT_EQ:
+        snprintf(out, length, "SNE  V%X, 0x%02X", X, NN);
+        return;
+    case INST_SKIP_V_EQ:
+        snprintf(out, length, "SE   V%X, V%X", X, Y);
+        return;
+    case INST_SETVX:
+        snprintf(out, length, "LD   V%X, 0x%02X", X, NN);
+        return;
+    case INST_ADDVX:
+        snprintf(out, length, "ADD  V%X, 0x%02X", X, NN);
+        return;
+    case INST_MATH:
+    {
+        const char *operation = NULL;
+        switch (N)
+        {
+        case 0x0:
+            operation = "LD  ";
+            break;
+        case 0x1:
+            operation = "OR  ";
+            break;
+        case 0x2:
+            operation = "AND ";
+            break;
+        case 0x3:
+            operation = "XOR ";
+            break;
+        case 0x4:
+            operation = "ADD ";
+            break;
+        case 0x5:
+            operation = "SUB ";
+            break;
+        case 0x6:
+            operation = "SHR ";
+            break;
+        case 0x7:
+            operation = "SUBN";
+            break;
+        case 0xE:
+            operation = "SHL ";
+            break;
+        default:
+            break;
+        }
+
+        if (operation != NULL)
+        {
+            snprintf(out, length, "%s V%X, V%X", operation, X, Y);
+            return;
+        }
+        break;
+    }
+    case INST_SKIP_V_NOT_EQ:
+        snprintf(out, length, "SNE  V%X, V%X", X, Y);
+        return;
+    case INST_SETIR:
+        snprintf(out, length, "LD   I, 0x%03X", NNN);
+        return;
+    case INST_JUMP_OFFSET:
+#if CHIP48_BEHAVIOR == 1
+        snprintf(out, length, "JP   V%X, 0x%03X", X, NNN);
+#else
+        snprintf(out, length, "JP   V0, 0x%03X", NNN);
+#endif
+        return;
+    case INST_RANDOM:
+        snprintf(out, length, "RND  V%X, 0x%02X", X, NN);
+        return;
+    case INST_DRAW:
+        snprintf(out, length, "DRW  V%X, V%X, %u", X, Y, N);
+        return;
+    case INST_SKIP_IF_KEY:
+        if (NN == 0x9E)
+        {
+            snprintf(out, length, "SKP  V%X", X);
+            return;
+        }
+        if (NN == 0xA1)
+        {
+            snprintf(out, length, "SKNP V%X", X);
+            return;
+        }
+        break;
+    case INST_TIMER:
+        switch (NN)
+        {
+        case 0x07:
+            snprintf(out, length, "LD   V%X, DT", X);
+            return;
+        case 0x0A:
+            snprintf(out, length, "LD   V%X, K", X);
+            return;
+        case 0x15:
+            snprintf(out, length, "LD   DT, V%X", X);
+            return;
+        case 0x18:
+            snprintf(out, length, "LD   ST, V%X", X);
+            return;
+        case 0x1E:
+            snprintf(out, length, "ADD  I, V%X", X);
+            return;
+        case 0x29:
+            snprintf(out, length, "LD   F, V%X", X);
+            return;
+        case 0x33:
+            snprintf(out, length, "LD   B, V%X", X);
+            return;
+        case 0x55:
+            snprintf(out, length, "LD   [I], V%X", X);
+            return;
+        case 0x65:
+            snprintf(out, length, "LD   V%X, [I]", X);
+            return;
+        default:
+            break;
+        }
+        break;
+    default:
+        break;
+    }
+
+    snprintf(out, length, "DW   0x%04X", instruction);
+}
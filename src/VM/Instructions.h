@@ -1,5 +1,12 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+
+// Interpreter quirks, shared by the VM and the disassembler so both agree
+#define CHIP8_SHIFT_LEGACY_BEHAVIOR 0
+#define CHIP48_BEHAVIOR 1
+
 #define INST_CLEAR_SCREEN 0x0000
 #define INST_JUMP 0x1000
 #define INST_SETVX 0x6000
@@ -21,4 +28,5 @@
 
 #define INST_SKIP_IF_KEY 0xE000
 #define INST_TIMER 0xF000
-const char *opcode_to_cstr(uint16_t opcode);
\ No newline at end of file
+const char *opcode_to_cstr(uint16_t opcode);
+void instruction_disassemble(uint16_t instruction, char *out, size_t length);
\ No newline at end of file
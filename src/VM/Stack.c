@@ -1,4 +1,4 @@
-#include "Stack.h"
+#include "VM.h"
 
 int stack_push(Stack *stack, uint16_t value)
 {
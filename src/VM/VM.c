@@ -1,15 +1,8 @@
-#pragma once
-
 #include "VM.h"
-#include "Instructions.c"
 #include <stdio.h>
-#include "Display.c"
-#include "Stack.c"
+#include "Instructions.h"
 #include "Keyboard.h"
 
-#define CHIP8_SHIFT_LEGACY_BEHAVIOR 0
-#define CHIP48_BEHAVIOR 1
-
 const char *vmerror_to_cstr(VMError error)
 {
     switch (error)
@@ -42,6 +35,27 @@ VM *vm_new(void)
     return vm;
 }
 
+// Each VM has its own generator so runs are reproducible from a seed and VMs on different threads don't share state
+void vm_seed_random(VM *vm, uint32_t seed)
+{
+    vm->random_state = seed != 0 ? seed : 0x9E3779B9;
+}
+
+static uint8_t vm_random(VM *vm)
+{
+    if (vm->random_state == 0)
+    {
+        vm_seed_random(vm, 0);
+    }
+
+    uint32_t x = vm->random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    vm->random_state = x;
+    return (uint8_t)(x >> 24);
+}
+
 void vm_free(VM *vm)
 {
     if (vm != NULL)
@@ -71,36 +85,43 @@ int vm_load_program(VM *vm, const char *filename)
         return 1;
     }
 
-    fseek(file, 0, SEEK_END);
-    size_t file_size = (size_t)ftell(file);
-    fseek(file, 0, SEEK_SET);
+    // One byte more than fits, so oversized files are detected without seeking
+    uint8_t buffer[VM_MEMORY_SIZE - 0x200 + 1];
+    size_t file_size = fread(buffer, 1, sizeof(buffer), file);
+    int read_error = ferror(file);
+    fclose(file);
+
+    if (read_error)
+    {
+        fprintf(stderr, "Error: Unable to read file %s.\n", filename);
+        return 1;
+    }
 
     if (file_size > VM_MEMORY_SIZE - 0x200)
     {
         fprintf(stderr, "Error: File %s is too large to load into memory.\n", filename);
-        fclose(file);
         return 1;
     }
 
-    uint8_t *buffer = (uint8_t *)malloc(file_size);
-    if (buffer == NULL)
+    return vm_load_program_memory(vm, buffer, file_size);
+}
+
+int vm_load_program_memory(VM *vm, const uint8_t *program, size_t size)
+{
+    if (size > VM_MEMORY_SIZE - 0x200)
     {
-        fprintf(stderr, "Error: Unable to allocate memory for file %s.\n", filename);
-        fclose(file);
+        fprintf(stderr, "Error: Program of %zu bytes is too large to load into memory.\n", size);
         return 1;
     }
 
-    fread(buffer, 1, file_size, file);
-    fclose(file);
-
-    vm_memcpy(vm, 0x200, buffer, file_size);
-    free(buffer);
+    memcpy(vm->memory + 0x200, program, size);
     return 0;
 }
 
-INST vm_fetch(VM *vm)
+INST vm_fetch(const VM *vm)
 {
-    INST instruction = (vm->memory[vm->program_counter] << 8) | vm->memory[vm->program_counter + 1];
+    size_t address = vm->program_counter & VM_ADDRESS_MASK;
+    INST instruction = (INST)(vm->memory[address] << 8 | vm->memory[(address + 1) & VM_ADDRESS_MASK]);
     return instruction;
 }
 
@@ -158,11 +179,12 @@ VMError vm_execute(VM *vm, Keyboard *keyboard)
         printf("Drawing X: %i DX: %i Y: %i DY: %i HEIGHT: %i\n", X, dx, Y, dy, height);
 #endif
         int pixel;
+        size_t address = vm->index_register;
         vm->variable_registers[0xF] = 0;
 
         for (int y = 0; y < height; y++)
         {
-            pixel = vm->memory[vm->index_register + y];
+            pixel = vm->memory[(address + (size_t)y) & VM_ADDRESS_MASK];
             for (int x = 0; x < 8; x++)
             {
                 if (pixel & (0x80 >> x))
@@ -174,6 +196,7 @@ VMError vm_execute(VM *vm, Keyboard *keyboard)
                         vm->variable_registers[0xF] = 1;
                     }
                     vm->display.pixels[draw_y][draw_x] ^= 1;
+                    vm->display.changes[draw_y] ^= 1ULL << draw_x;
                 }
             }
         }
@@ -306,17 +329,17 @@ VMError vm_execute(VM *vm, Keyboard *keyboard)
     {
 #if CHIP48_BEHAVIOR == 1
         // Jump to address XNN + value in register VX
-        vm->program_counter = vm->variable_registers[X] + (opcode & 0x0FFF);
+        vm->program_counter = vm->variable_registers[X] + NNN;
 #else
         // Jump to address NNN + value in register V0
-        vm->program_counter = vm->variable_registers[0] + (opcode & 0x0FFF);
+        vm->program_counter = vm->variable_registers[0] + NNN;
 #endif
         pcIncrement = 0;
         break;
     }
     case INST_RANDOM:
     {
-        vm->variable_registers[X] = (uint8_t)((rand() % 256) & NN);
+        vm->variable_registers[X] = vm_random(vm) & NN;
         break;
     }
     case INST_SKIP_IF_KEY:
@@ -325,7 +348,7 @@ VMError vm_execute(VM *vm, Keyboard *keyboard)
         {
         case 0x9E:
         {
-            if (keyboard->keys[vm->variable_registers[X]])
+            if (keyboard->keys[vm->variable_registers[X] & 0x0F])
             {
                 pcIncrement += 2;
             }
@@ -333,7 +356,7 @@ VMError vm_execute(VM *vm, Keyboard *keyboard)
         }
         case 0xA1:
         {
-            if (!keyboard->keys[vm->variable_registers[X]])
+            if (!keyboard->keys[vm->variable_registers[X] & 0x0F])
             {
                 pcIncrement += 2;
             }
@@ -374,7 +397,7 @@ VMError vm_execute(VM *vm, Keyboard *keyboard)
         }
         case 0x0A:
         {
-            if (!keyboard->keys[vm->variable_registers[X]])
+            if (!keyboard->keys[vm->variable_registers[X] & 0x0F])
             {
                 pcIncrement -= 2;
             }
@@ -399,24 +422,39 @@ VMError vm_execute(VM *vm, Keyboard *keyboard)
             v /= 10;
             uint8_t hundreds = v % 10;
 
-            vm->memory[vm->index_register] = hundreds;
-            vm->memory[vm->index_register + 1] = tens;
-            vm->memory[vm->index_register + 2] = ones;
+            size_t address = vm->index_register;
+            vm->memory[address & VM_ADDRESS_MASK] = hundreds;
+            vm->memory[(address + 1) & VM_ADDRESS_MASK] = tens;
+            vm->memory[(address + 2) & VM_ADDRESS_MASK] = ones;
             break;
         }
         case 0x55:
         {
-            for (int i = 0; i <= X; i++)
+            size_t address = vm->index_register & VM_ADDRESS_MASK;
+            size_t count = (size_t)X + 1;
+            if (address + count <= VM_MEMORY_SIZE)
             {
-                vm->memory[vm->index_register + i] = vm->variable_registers[i];
+                memcpy(&vm->memory[address], vm->variable_registers, count);
+                break;
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                vm->memory[(address + i) & VM_ADDRESS_MASK] = vm->variable_registers[i];
             }
             break;
         }
         case 0x65:
         {
-            for (int i = 0; i <= X; i++)
+            size_t address = vm->index_register & VM_ADDRESS_MASK;
+            size_t count = (size_t)X + 1;
+            if (address + count <= VM_MEMORY_SIZE)
+            {
+                memcpy(vm->variable_registers, &vm->memory[address], count);
+                break;
+            }
+            for (size_t i = 0; i < count; i++)
             {
-                vm->variable_registers[i] = vm->memory[vm->index_register + i];
+                vm->variable_registers[i] = vm->memory[(address + i) & VM_ADDRESS_MASK];
             }
             break;
         }
@@ -431,6 +469,39 @@ VMError vm_execute(VM *vm, Keyboard *keyboard)
         return VMERROR_UNSUPPORTED_OPCODE;
     }
 
-    vm->program_counter += (size_t)pcIncrement;
+    vm->program_counter = (vm->program_counter + (size_t)pcIncrement) & VM_ADDRESS_MASK;
+    vm->cycles++;
     return VMERROR_OK;
+}
+
+VMError vm_run_frame(VM *vm, Keyboard *keyboard, InputQueue *input, unsigned int instructions)
+{
+    for (unsigned int i = 0; i < instructions; i++)
+    {
+        input_queue_apply(input, keyboard, vm->cycles);
+        VMError error = vm_execute(vm, keyboard);
+        if (error != VMERROR_OK)
+        {
+            display_commit(&vm->display);
+            return error;
+        }
+    }
+
+    display_commit(&vm->display);
+    vm_tick_timers(vm);
+    return VMERROR_OK;
+}
+
+// Timers run at 60Hz, one tick per emulated frame
+void vm_tick_timers(VM *vm)
+{
+    if (vm->delay_timer > 0)
+    {
+        vm->delay_timer -= 1;
+    }
+
+    if (vm->sound_timer > 0)
+    {
+        vm->sound_timer -= 1;
+    }
 }
\ No newline at end of file
@@ -6,11 +6,17 @@
 #include "Display.h"
 #include "Stack.h"
 #include "Keyboard.h"
+#include "InputQueue.h"
 #define VM_MEMORY_SIZE 4096
+// Addresses wrap around like on the 12-bit address bus of the original, which
+// keeps every index relative access in bounds without a branch
+#define VM_ADDRESS_MASK (VM_MEMORY_SIZE - 1)
 #define VM_VARIABLE_REGISTER_COUNT 16
 
 typedef uint16_t INST;
 
+_Static_assert((VM_MEMORY_SIZE & VM_ADDRESS_MASK) == 0, "VM_MEMORY_SIZE must be a power of two");
+
 typedef enum VMError
 {
     VMERROR_OK = 0,
@@ -31,12 +37,18 @@ typedef struct
     uint8_t delay_timer;
     uint8_t sound_timer;
     uint8_t variable_registers[VM_VARIABLE_REGISTER_COUNT];
+    uint64_t cycles;
+    uint32_t random_state;
 } VM;
 
 VM *vm_new(void);
+void vm_seed_random(VM *vm, uint32_t seed);
 void vm_free(VM *vm);
 
 void vm_memcpy(VM *vm, size_t start, void *source, size_t length);
 int vm_load_program(VM *vm, const char *filename);
-INST vm_fetch(VM *vm);
-VMError vm_execute(VM *vm, Keyboard *keyboard);
\ No newline at end of file
+int vm_load_program_memory(VM *vm, const uint8_t *program, size_t size);
+INST vm_fetch(const VM *vm);
+VMError vm_execute(VM *vm, Keyboard *keyboard);
+VMError vm_run_frame(VM *vm, Keyboard *keyboard, InputQueue *input, unsigned int instructions);
+void vm_tick_timers(VM *vm);
\ No newline at end of file
@@ -1,75 +1,129 @@
 #include <stdio.h>
 #include <string.h>
-#include <time.h>
 
 #include "SDL2/SDL.h"
 
-#include "Data/Font.h"
-
-#include "VM/VM.c"
-
-#include "Rendering/RenderContext.c"
-#include "Rendering/DisplayRenderer.c"
-
-#define TARGET_FPS 60
-#define TARGET_IPS 800
-
-void update_keyboard(SDL_Event *event, Keyboard *keyboard);
+#include "Options.h"
+#include "Util/Clock.h"
+#include "Util/Histogram.h"
+#include "VM/VM.h"
+#include "Capture/Capture.h"
+#include "Share/SharedState.h"
+#include "Stream/StreamProtocol.h"
+#include "Stream/StreamServer.h"
+#include "Debugger/Debugger.h"
+#include "Grid/WorkerPool.h"
+#include "Grid/Grid.h"
+#include "Session.h"
+
+#include "Rendering/RenderContext.h"
+#include "Rendering/Filters.h"
+#include "Rendering/DisplayRenderer.h"
+#include "Rendering/FramePacer.h"
+
+int map_key(SDL_Keycode sym);
+int run_grid(const Options *options);
+uint64_t event_cycle(uint32_t timestamp, uint32_t anchor_ticks, uint64_t anchor_cycle, unsigned int ips);
 
 int main(int argc, char *argv[])
 {
-    srand((unsigned int)time(NULL));
     if (argc < 2)
     {
-        printf("Usage: chip8 <path-to-rom>\n");
+        print_usage();
         return 0;
     }
 
-    const char *file_path = argv[1];
-
-    VM *vm = vm_new();
+    Options options = {0};
+    if (parse_options(&options, argc, argv) != 0)
+    {
+        print_usage();
+        return 1;
+    }
 
-    vm_memcpy(vm, 0x0, (void *)FONT_DATA, FONT_DATA_SIZE);
+    int batch = session_run_batch(&options, (size_t)SDL_GetCPUCount());
+    if (batch != SESSION_NOT_BATCH)
+    {
+        return batch;
+    }
 
-    printf("Loading program %s\n", file_path);
+    if (options.grid)
+    {
+        return run_grid(&options);
+    }
 
-    if (vm_load_program(vm, file_path) != 0)
+    Session session;
+    if (session_open(&session, &options) != 0)
     {
         return 1;
     }
 
-    vm->program_counter = 0x200;
+    if (options.headless)
+    {
+        int status = session_run_headless(&session, &options);
+        if (session_close(&session) != 0)
+        {
+            status = 1;
+        }
+        return status;
+    }
+
+    VM *vm = session.vm;
+    SharedState *shared = session.shared;
+    Capture *capture = session.capture;
+    StreamServer *stream = session.stream;
+    Debugger *debugger = session.debugger;
 
     printf("Initializing graphics\n");
 
     RenderContext render_context = {0};
 
-    if (init_render_context(&render_context) != 0)
+    if (init_render_context(&render_context, !options.no_vsync) != 0)
     {
         fprintf(stderr, "ERROR: Failed to initialize graphics.");
+        session_close(&session);
+        return 1;
+    }
+
+    FilterState *filter = filter_state_new(options.filter);
+    if (filter == NULL)
+    {
+        fprintf(stderr, "ERROR: Failed to allocate filter state.");
+        session_close(&session);
         return 1;
     }
 
+    FramePacer pacer;
+    frame_pacer_init(&pacer, &render_context, TARGET_FPS);
+    printf("Frame pacing: %s\n", pacing_mode_to_cstr(pacer.mode));
+
     SDL_Event event;
 
     int running = 1;
 
-    uint64_t NOW = SDL_GetPerformanceCounter();
-    uint64_t LAST = 0;
-    double deltaTime = 0;
-
-    double drawTimer = 0;
-    double instructionTimer = 0;
-    double secondTimer = 0;
+    double secondTimer = frame_pacer_now_ms();
+    double instructionBudget = 0;
 
     int drawTimes = 0;
     int instructionTimes = 0;
-    char *title = malloc(32 * sizeof(char));
+    char *title = malloc(96 * sizeof(char));
 
     Keyboard keyboard = {0};
+    InputQueue input = {0};
+
+    // Input polled at the start of a frame happened during the previous one, so it is spread
+    // over the cycles of the frame about to run relative to the previous frame's tick
+    uint32_t anchor_ticks = SDL_GetTicks();
+    uint64_t anchor_cycle = 0;
+
+    Histogram latency;
+    histogram_reset(&latency);
+    double pending_press_ms = -1;
 
     while (running)
     {
+        uint32_t frame_ticks = SDL_GetTicks();
+        anchor_cycle = vm->cycles;
+
         while (SDL_PollEvent(&event))
         {
             if (event.type == SDL_QUIT)
@@ -77,125 +131,260 @@ int main(int argc, char *argv[])
                 running = 0;
             }
 
-            if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP)
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F12 && debugger != NULL)
             {
-                update_keyboard(&event, &keyboard);
+                debugger->paused = true;
+                snprintf(debugger->reason, sizeof(debugger->reason), "user break");
+            }
+
+            if ((event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) && !event.key.repeat)
+            {
+                int key = map_key(event.key.keysym.sym);
+                if (key < 0)
+                {
+                    continue;
+                }
+
+                InputEvent input_event = {
+                    .cycle = event_cycle(event.key.timestamp, anchor_ticks, anchor_cycle, options.ips),
+                    .key = (uint8_t)key,
+                    .pressed = event.type == SDL_KEYDOWN,
+                };
+                input_queue_push(&input, input_event);
+
+                if (input_event.pressed && pending_press_ms < 0)
+                {
+                    // Account for the time the event spent in SDL's queue before we polled it
+                    pending_press_ms = frame_pacer_now_ms() - (double)(SDL_GetTicks() - event.key.timestamp);
+                }
             }
         }
 
-        NOW = SDL_GetPerformanceCounter();
+        anchor_ticks = frame_ticks;
 
-        deltaTime = (double)((double)(NOW - LAST) * (double)1000.0 / (double)SDL_GetPerformanceFrequency());
-        LAST = NOW;
+        if (debugger != NULL && debugger->paused && debugger_prompt(debugger, vm) != 0)
+        {
+            break;
+        }
 
-        drawTimer += deltaTime;
-        secondTimer += deltaTime;
-        instructionTimer += deltaTime;
+        instructionBudget += (double)options.ips / TARGET_FPS;
+        unsigned int instructions = (unsigned int)instructionBudget;
+        instructionBudget -= instructions;
 
-        if (drawTimer > 1000 / TARGET_FPS)
+        if (shared != NULL)
         {
-            drawTimer = 0;
-            // Decrease timers 60 times per second
-            if (vm->delay_timer > 0)
-            {
-                vm->delay_timer -= 1;
-            }
+            shared_state_begin_write(shared);
+        }
+
+        VMError error = debugger != NULL ? debugger_run_frame(debugger, vm, &keyboard, &input, instructions)
+                                         : vm_run_frame(vm, &keyboard, &input, instructions);
 
-            if (vm->sound_timer > 0)
+        if (shared != NULL)
+        {
+            shared_state_end_write(shared);
+        }
+
+        if (error != VMERROR_OK)
+        {
+            fprintf(stderr, "ERROR: %s\n", vmerror_to_cstr(error));
+            if (debugger != NULL)
             {
-                vm->sound_timer -= 1;
+                debugger_prompt(debugger, vm);
             }
+            running = 0;
+        }
+        instructionTimes += (int)instructions;
 
-            render_display(&render_context, &vm->display);
-            drawTimes += 1;
+        if (capture != NULL)
+        {
+            capture_frame(capture, &vm->display);
         }
 
-        if (instructionTimer > 1000.0 / TARGET_IPS)
+        if (stream != NULL)
         {
-            instructionTimer = 0;
-            VMError error = vm_execute(vm, &keyboard);
-            if (error != VMERROR_OK)
+            stream_server_broadcast(stream, &vm->display);
+        }
+
+        render_display(&render_context, filter, &vm->display);
+        frame_pacer_present(&pacer, &render_context);
+        drawTimes += 1;
+
+        if (vm->display.dirty)
+        {
+            vm->display.dirty = false;
+            if (options.measure_latency && pending_press_ms >= 0)
             {
-                fprintf(stderr, "ERROR: %s\n", vmerror_to_cstr(error));
-                running = 0;
+                histogram_record(&latency, pacer.last_present_ms - pending_press_ms);
+                pending_press_ms = -1;
             }
-            instructionTimes += 1;
         }
 
-        if (secondTimer > 1000)
+        if (pacer.last_present_ms - secondTimer > 1000)
         {
-            snprintf(title, 32, "chip8 - FPS: %i | IPS: %i", drawTimes, instructionTimes);
+            snprintf(title, 96, "chip8 - FPS: %i | IPS: %i | Jitter p99: %.2fms | Filter: %.3fms", drawTimes, instructionTimes, histogram_percentile(&pacer.jitter, 99), filter->apply_ms);
             SDL_SetWindowTitle(render_context.window, title);
-            secondTimer = 0;
+            secondTimer = pacer.last_present_ms;
             drawTimes = 0;
             instructionTimes = 0;
         }
+    }
 
-        SDL_RenderPresent(render_context.renderer);
+    if (options.frame_stats)
+    {
+        histogram_print(&pacer.jitter, "Frame jitter", stdout);
+    }
+
+    if (options.measure_latency)
+    {
+        histogram_print(&latency, "Input latency", stdout);
     }
 
     free(title);
-    vm_free(vm);
+    filter_state_free(filter);
+    session_close(&session);
     printf("Disposing graphics");
     dispose_render_context(&render_context);
 
     return 0;
 }
 
-void update_keyboard(SDL_Event *event, Keyboard *keyboard)
+int map_key(SDL_Keycode sym)
 {
-    int keydown = event->type == SDL_KEYDOWN;
-    switch (event->key.keysym.sym)
+    switch (sym)
     {
     case SDLK_1:
-        keyboard->keys[0x1] = keydown > 0;
-        break;
+        return 0x1;
     case SDLK_2:
-        keyboard->keys[0x2] = keydown > 0;
-        break;
+        return 0x2;
     case SDLK_3:
-        keyboard->keys[0x3] = keydown > 0;
-        break;
+        return 0x3;
     case SDLK_4:
-        keyboard->keys[0xc] = keydown > 0;
-        break;
+        return 0xc;
     case SDLK_q:
-        keyboard->keys[0x4] = keydown > 0;
-        break;
+        return 0x4;
     case SDLK_w:
-        keyboard->keys[0x5] = keydown > 0;
-        break;
+        return 0x5;
     case SDLK_e:
-        keyboard->keys[0x6] = keydown > 0;
-        break;
+        return 0x6;
     case SDLK_r:
-        keyboard->keys[0xD] = keydown > 0;
-        break;
+        return 0xD;
     case SDLK_a:
-        keyboard->keys[0x7] = keydown > 0;
-        break;
+        return 0x7;
     case SDLK_s:
-        keyboard->keys[0x8] = keydown > 0;
-        break;
+        return 0x8;
     case SDLK_d:
-        keyboard->keys[0x9] = keydown > 0;
-        break;
+        return 0x9;
     case SDLK_f:
-        keyboard->keys[0xE] = keydown > 0;
-        break;
+        return 0xE;
     case SDLK_z:
-        keyboard->keys[0xA] = keydown > 0;
-        break;
+        return 0xA;
     case SDLK_x:
-        keyboard->keys[0x0] = keydown > 0;
-        break;
+        return 0x0;
     case SDLK_c:
-        keyboard->keys[0xB] = keydown > 0;
-        break;
+        return 0xB;
     case SDLK_v:
-        keyboard->keys[0xF] = keydown > 0;
-        break;
+        return 0xF;
     default:
-        break;
+        return -1;
+    }
+}
+
+uint64_t event_cycle(uint32_t timestamp, uint32_t anchor_ticks, uint64_t anchor_cycle, unsigned int ips)
+{
+    // Events older than the anchor are applied before the next instruction
+    if (timestamp <= anchor_ticks)
+    {
+        return anchor_cycle;
+    }
+
+    return anchor_cycle + (uint64_t)(timestamp - anchor_ticks) * ips / 1000;
+}
+
+int run_grid(const Options *options)
+{
+    size_t threads = options->threads > 0 ? options->threads : (size_t)SDL_GetCPUCount();
+
+    printf("Loading %zu programs on %zu threads\n", options->rom_count, threads);
+
+    Grid *grid = grid_new(options->rom_paths, options->rom_count, threads);
+    if (grid == NULL)
+    {
+        return 1;
+    }
+
+    RenderContext render_context = {0};
+    if (init_render_context(&render_context, !options->no_vsync) != 0)
+    {
+        fprintf(stderr, "ERROR: Failed to initialize graphics.");
+        grid_free(grid);
+        return 1;
     }
+
+    FramePacer pacer;
+    frame_pacer_init(&pacer, &render_context, TARGET_FPS);
+
+    SDL_Event event;
+    int running = 1;
+
+    double secondTimer = frame_pacer_now_ms();
+    double instructionBudget = 0;
+    int drawTimes = 0;
+    char title[96];
+
+    uint32_t anchor_ticks = SDL_GetTicks();
+
+    while (running)
+    {
+        uint32_t frame_ticks = SDL_GetTicks();
+
+        while (SDL_PollEvent(&event))
+        {
+            if (event.type == SDL_QUIT)
+            {
+                running = 0;
+            }
+
+            if ((event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) && !event.key.repeat)
+            {
+                int key = map_key(event.key.keysym.sym);
+                if (key >= 0)
+                {
+                    grid_push_key(grid, (uint8_t)key, event.type == SDL_KEYDOWN, event_cycle(event.key.timestamp, anchor_ticks, 0, options->ips));
+                }
+            }
+        }
+
+        anchor_ticks = frame_ticks;
+
+        instructionBudget += (double)options->ips / TARGET_FPS;
+        unsigned int instructions = (unsigned int)instructionBudget;
+        instructionBudget -= instructions;
+
+        grid_run_frame(grid, instructions);
+
+        render_pixels(&render_context, grid->pixels, grid->width, grid->height, (float)grid->width / (float)grid->height);
+        frame_pacer_present(&pacer, &render_context);
+        drawTimes += 1;
+
+        if (pacer.last_present_ms - secondTimer > 1000)
+        {
+            uint64_t total_ips = 0;
+            for (size_t i = 0; i < grid->count; i++)
+            {
+                total_ips += grid->instances[i].second_instructions;
+            }
+            grid_end_second(grid);
+
+            snprintf(title, sizeof(title), "chip8 - %zu instances | FPS: %i | IPS: %llu", grid->count, drawTimes, (unsigned long long)total_ips);
+            SDL_SetWindowTitle(render_context.window, title);
+            secondTimer = pacer.last_present_ms;
+            drawTimes = 0;
+        }
+    }
+
+    grid_free(grid);
+    printf("Disposing graphics");
+    dispose_render_context(&render_context);
+
+    return 0;
 }
@@ -0,0 +1,64 @@
+// chip8-headless: the frontend without a window, for servers, CI and
+// profiling. It doesn't link SDL and implies --headless.
+
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "Options.h"
+#include "Session.h"
+
+static size_t cpu_count(void)
+{
+#ifdef _WIN32
+    return 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (size_t)count : 1;
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        print_usage();
+        return 0;
+    }
+
+    Options options = {0};
+    if (parse_options(&options, argc, argv) != 0)
+    {
+        print_usage();
+        return 1;
+    }
+
+    int batch = session_run_batch(&options, cpu_count());
+    if (batch != SESSION_NOT_BATCH)
+    {
+        return batch;
+    }
+
+    if (options.grid)
+    {
+        fprintf(stderr, "ERROR: --grid needs a window, use chip8 instead of chip8-headless\n");
+        return 1;
+    }
+
+    options.headless = true;
+
+    Session session;
+    if (session_open(&session, &options) != 0)
+    {
+        return 1;
+    }
+
+    int status = session_run_headless(&session, &options);
+    if (session_close(&session) != 0)
+    {
+        status = 1;
+    }
+    return status;
+}
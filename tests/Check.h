@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdio.h>
+
+// Minimal assertions for the programs in tests/, each of which is a single
+// translation unit returning check_result() from main
+static int check_failures = 0;
+
+#define CHECK(condition)                                                              \
+    do                                                                                \
+    {                                                                                 \
+        if (!(condition))                                                             \
+        {                                                                             \
+            fprintf(stderr, "FAIL: %s:%d: %s\n", __FILE__, __LINE__, #condition);     \
+            check_failures++;                                                         \
+        }                                                                             \
+    } while (0)
+
+static inline int check_result(const char *name)
+{
+    if (check_failures == 0)
+    {
+        printf("PASS: %s\n", name);
+    }
+    return check_failures != 0;
+}
@@ -0,0 +1,238 @@
+// Runs random ROMs through both interpreter loops, meant to be built with the
+// sanitizers (make fuzz). The ROMs favour the index relative instructions,
+// DXYN, FX33, FX55 and FX65, with I close to the end of memory so their
+// accesses wrap. Every ROM runs through vm_run_frame and through
+// debugger_run_frame without breakpoints, which must end in the same state,
+// and once more with watchpoints and breakpoints that keep interrupting it.
+// The interpreter complains about unknown instructions on stdout, so results
+// go to stderr and make fuzz discards stdout.
+//
+//   fuzz_vm [runs] [seed]
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Check.h"
+#include "Data/Font.h"
+#include "Debugger/Debugger.h"
+#include "VM/VM.h"
+
+#define FUZZ_ROM_SIZE (VM_MEMORY_SIZE - 0x200)
+#define FUZZ_FRAMES 60
+#define FUZZ_INSTRUCTIONS_PER_FRAME 500
+#define FUZZ_DEFAULT_RUNS 2000
+
+static uint32_t fuzz_state;
+
+// xorshift32, the C library's rand() differs between platforms
+static uint32_t fuzz_random(void)
+{
+    fuzz_state ^= fuzz_state << 13;
+    fuzz_state ^= fuzz_state >> 17;
+    fuzz_state ^= fuzz_state << 5;
+    return fuzz_state;
+}
+
+static uint16_t fuzz_register(void)
+{
+    return (uint16_t)((fuzz_random() & 0xF) << 8);
+}
+
+static uint16_t fuzz_instruction(void)
+{
+    uint32_t roll = fuzz_random() % 100;
+    if (roll < 20)
+    {
+        return (uint16_t)(0xAF00 | (fuzz_random() & 0xFF)); // LD I, 0xF00..0xFFF
+    }
+    if (roll < 32)
+    {
+        return (uint16_t)(0xF000 | fuzz_register() | (fuzz_random() & 1 ? 0x55 : 0x65));
+    }
+    if (roll < 40)
+    {
+        return (uint16_t)(0xF033 | fuzz_register());
+    }
+    if (roll < 52)
+    {
+        return (uint16_t)(0xD000 | (fuzz_random() & 0xFFF));
+    }
+    if (roll < 57)
+    {
+        return (uint16_t)(0xF01E | fuzz_register());
+    }
+    if (roll < 60)
+    {
+        return (uint16_t)(0xF029 | fuzz_register());
+    }
+    if (roll < 97)
+    {
+        // Any other instruction the VM implements, with random operands
+        static const uint16_t forms[] = {0x00E0, 0x00EE, 0x1000, 0x2000, 0x3000, 0x4000, 0x5000, 0x6000, 0x7000,
+                                         0x8000, 0x8001, 0x8002, 0x8003, 0x8004, 0x8005, 0x8006, 0x8007, 0x800E,
+                                         0x9000, 0xB000, 0xC000, 0xE09E, 0xE0A1, 0xF007, 0xF00A, 0xF015, 0xF018};
+        uint16_t form = forms[fuzz_random() % (sizeof(forms) / sizeof(forms[0]))];
+        switch (form & 0xF000)
+        {
+        case 0x0000:
+            return form;
+        case 0x5000:
+        case 0x8000:
+        case 0x9000:
+            return (uint16_t)(form | fuzz_register() | (fuzz_random() & 0x00F0));
+        case 0xE000:
+        case 0xF000:
+            return (uint16_t)(form | fuzz_register());
+        default:
+            return (uint16_t)(form | (fuzz_random() & 0x0FFF));
+        }
+    }
+    // Anything, including opcodes the VM rejects
+    return (uint16_t)fuzz_random();
+}
+
+static VM *fuzz_vm_new(const uint8_t *rom, uint32_t seed)
+{
+    VM *vm = vm_new();
+    if (vm == NULL)
+    {
+        return NULL;
+    }
+    vm_seed_random(vm, seed);
+    vm_memcpy(vm, 0x0, (void *)FONT_DATA, FONT_DATA_SIZE);
+    vm_load_program_memory(vm, rom, FUZZ_ROM_SIZE);
+    vm->program_counter = 0x200;
+    return vm;
+}
+
+// Key changes at the start of some frames, the same for every loop
+static void fuzz_press_keys(const VM *vm, InputQueue *input, const uint8_t *presses, int frame)
+{
+    uint8_t press = presses[frame];
+    if (press != 0)
+    {
+        InputEvent event = {.cycle = vm->cycles, .key = press & 0xF, .pressed = (press & 0x10) != 0};
+        input_queue_push(input, event);
+    }
+}
+
+// Returns the error the run stopped on
+static VMError fuzz_run(VM *vm, Debugger *debugger, const uint8_t *presses)
+{
+    Keyboard keyboard = {0};
+    InputQueue input = {0};
+
+    for (int frame = 0; frame < FUZZ_FRAMES; frame++)
+    {
+        fuzz_press_keys(vm, &input, presses, frame);
+
+        VMError error;
+        if (debugger != NULL)
+        {
+            error = debugger_run_frame(debugger, vm, &keyboard, &input, FUZZ_INSTRUCTIONS_PER_FRAME);
+        }
+        else
+        {
+            error = vm_run_frame(vm, &keyboard, &input, FUZZ_INSTRUCTIONS_PER_FRAME);
+        }
+
+        if (error != VMERROR_OK)
+        {
+            return error;
+        }
+    }
+
+    return VMERROR_OK;
+}
+
+// Like a user continuing every time the debugger stops, so both the checks
+// that stop and the resume path run many times per frame
+static void fuzz_run_interrupted(VM *vm, const uint8_t *presses)
+{
+    Debugger debugger = {0};
+    debugger_add_watchpoint(&debugger, (Watchpoint){.start = 0xFF0, .end = 0xFFF});
+    debugger_add_watchpoint(&debugger, (Watchpoint){.start = 0x000, .end = 0x00F});
+    debugger_add_breakpoint(&debugger, (Breakpoint){.any_address = true, .condition = CONDITION_EQUAL, .condition_register = 0xF, .condition_value = 1});
+    debugger_add_breakpoint(&debugger, (Breakpoint){.address = 0x200});
+
+    Keyboard keyboard = {0};
+    InputQueue input = {0};
+
+    for (int frame = 0; frame < FUZZ_FRAMES; frame++)
+    {
+        fuzz_press_keys(vm, &input, presses, frame);
+
+        if (debugger_run_frame(&debugger, vm, &keyboard, &input, FUZZ_INSTRUCTIONS_PER_FRAME) != VMERROR_OK)
+        {
+            return;
+        }
+        if (debugger.paused)
+        {
+            debugger_continue(&debugger);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long runs = argc > 1 ? strtoul(argv[1], NULL, 0) : FUZZ_DEFAULT_RUNS;
+    fuzz_state = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1;
+    if (fuzz_state == 0)
+    {
+        fuzz_state = 1;
+    }
+
+    uint8_t rom[FUZZ_ROM_SIZE];
+    uint8_t presses[FUZZ_FRAMES];
+    unsigned long errors = 0;
+    uint64_t instructions = 0;
+
+    for (unsigned long run = 0; run < runs; run++)
+    {
+        uint32_t seed = fuzz_random();
+        for (size_t i = 0; i < sizeof(rom); i += 2)
+        {
+            uint16_t instruction = fuzz_instruction();
+            rom[i] = (uint8_t)(instruction >> 8);
+            rom[i + 1] = (uint8_t)instruction;
+        }
+        for (int frame = 0; frame < FUZZ_FRAMES; frame++)
+        {
+            presses[frame] = fuzz_random() % 4 == 0 ? (uint8_t)(fuzz_random() & 0x1F) : 0;
+        }
+
+        VM *plain = fuzz_vm_new(rom, seed);
+        VM *debugged = fuzz_vm_new(rom, seed);
+        VM *interrupted = fuzz_vm_new(rom, seed);
+        if (plain == NULL || debugged == NULL || interrupted == NULL)
+        {
+            fprintf(stderr, "ERROR: Out of memory.\n");
+            return 1;
+        }
+
+        Debugger debugger = {0};
+        VMError plain_error = fuzz_run(plain, NULL, presses);
+        VMError debugged_error = fuzz_run(debugged, &debugger, presses);
+        fuzz_run_interrupted(interrupted, presses);
+
+        bool agree = plain_error == debugged_error && memcmp(plain, debugged, sizeof(VM)) == 0;
+        if (!agree)
+        {
+            fprintf(stderr, "FAIL: run %lu, vm_run_frame and debugger_run_frame disagree\n", run);
+        }
+        CHECK(agree);
+
+        errors += plain_error != VMERROR_OK;
+        instructions += plain->cycles + debugged->cycles + interrupted->cycles;
+
+        vm_free(plain);
+        vm_free(debugged);
+        vm_free(interrupted);
+    }
+
+    fprintf(stderr, "%lu ROMs, %llu instructions, %lu stopped on an error\n", runs, (unsigned long long)instructions, errors);
+    fprintf(stderr, "%s: fuzz vm\n", check_failures == 0 ? "PASS" : "FAIL");
+    return check_failures != 0;
+}
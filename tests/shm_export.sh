@@ -0,0 +1,77 @@
+#!/bin/sh
+# Runs counter.ch8 headless with --shm and checks that shm_reader sees
+# consistent, advancing snapshots, that a second instance can't take the
+# segment over, that the segment is gone after SIGTERM and that one left
+# behind by SIGKILL is replaced.
+#
+#   tests/shm_export.sh <build dir>
+
+set -u
+
+BUILD_DIR=${1:-./target/release}
+ROM=$(dirname "$0")/roms/counter.ch8
+SEGMENT=/chip8-check-$$
+OUTPUT=$(mktemp)
+
+fail()
+{
+    echo "FAIL: shm export: $1"
+    kill "$PID" 2>/dev/null
+    rm -f "$OUTPUT"
+    exit 1
+}
+
+# 600 IPS is exactly 10 instructions per frame, a snapshot torn between two
+# frames would break cycles == 10 * frame
+"$BUILD_DIR/chip8-headless" --headless --frames 1000000000 --ips 600 --shm "$SEGMENT" "$ROM" >/dev/null &
+PID=$!
+
+attached=0
+for attempt in 1 2 3 4 5 6 7 8 9 10; do
+    if "$BUILD_DIR/shm_reader" "$SEGMENT" 3 >"$OUTPUT" 2>/dev/null; then
+        attached=1
+        break
+    fi
+    sleep 0.2
+done
+[ "$attached" -eq 1 ] || fail "shm_reader couldn't read $SEGMENT"
+
+awk '
+    /^frame / {
+        samples++
+        if ($4 != 10 * $2) { print "cycles " $4 " at frame " $2; bad = 1 }
+        if (samples > 1 && $2 <= last) { print "frame " $2 " after " last; bad = 1 }
+        last = $2
+    }
+    END { exit bad || samples != 3 }
+' "$OUTPUT" || fail "inconsistent snapshots"
+
+# The segment belongs to a live instance, a second one must leave it alone
+if "$BUILD_DIR/chip8-headless" --headless --frames 10 --shm "$SEGMENT" "$ROM" >/dev/null 2>&1; then
+    fail "a second instance took over $SEGMENT"
+fi
+"$BUILD_DIR/shm_reader" "$SEGMENT" 1 >/dev/null 2>&1 || fail "$SEGMENT was lost to a second instance"
+
+kill -TERM "$PID"
+wait "$PID"
+status=$?
+[ "$status" -eq 0 ] || fail "chip8-headless exited with $status after SIGTERM"
+
+# The stop handler must have let the session unlink the segment
+if "$BUILD_DIR/shm_reader" "$SEGMENT" 1 >/dev/null 2>&1; then
+    fail "$SEGMENT still exists"
+fi
+
+# A killed instance leaves its segment behind, the next one replaces it
+"$BUILD_DIR/chip8-headless" --headless --frames 1000000000 --shm "$SEGMENT" "$ROM" >/dev/null &
+PID=$!
+for attempt in 1 2 3 4 5 6 7 8 9 10; do
+    "$BUILD_DIR/shm_reader" "$SEGMENT" 1 >/dev/null 2>&1 && break
+    sleep 0.2
+done
+kill -KILL "$PID"
+wait "$PID" 2>/dev/null
+"$BUILD_DIR/chip8-headless" --headless --frames 10 --shm "$SEGMENT" "$ROM" >/dev/null 2>&1 || fail "stale $SEGMENT wasn't replaced"
+
+rm -f "$OUTPUT"
+echo "PASS: shm export"
@@ -0,0 +1,235 @@
+// Runs a ROM with a stream server on a unix socket and follows the stream as
+// viewers would: one watching from the start, one leaving mid-run and one
+// attaching late. Every viewer still attached must decode the VM's display.
+//
+//   test_stream_loopback <rom>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "Check.h"
+#include "Data/Font.h"
+#include "Stream/StreamServer.h"
+#include "Util/Clock.h"
+#include "VM/VM.h"
+
+#define LOOPBACK_FRAMES 120
+// counter.ch8 shows all three digits after 32 frames, so the slot the leaving
+// viewer frees holds a non-blank base the late viewer must not inherit
+#define LOOPBACK_LEAVE_FRAME 32
+#define LOOPBACK_JOIN_FRAME 60
+#define LOOPBACK_INSTRUCTIONS 13
+
+#ifndef _WIN32
+
+typedef struct
+{
+    int fd;
+    uint8_t buffer[1 << 16];
+    size_t buffered;
+    uint64_t rows[VM_DISPLAY_HEIGHT];
+    uint32_t frame;
+    int messages;
+    int mismatches;
+} Viewer;
+
+static bool viewer_attach(Viewer *viewer, const char *address)
+{
+    memset(viewer, 0, sizeof(Viewer));
+    viewer->fd = stream_socket_open(address, false);
+    if (viewer->fd < 0)
+    {
+        return false;
+    }
+    fcntl(viewer->fd, F_SETFL, fcntl(viewer->fd, F_GETFL, 0) | O_NONBLOCK);
+    return true;
+}
+
+static void viewer_detach(Viewer *viewer)
+{
+    close(viewer->fd);
+    viewer->fd = -1;
+}
+
+// Applies every complete message waiting on the viewer's socket. Returns
+// false for a malformed or out of order message
+static bool viewer_drain(Viewer *viewer)
+{
+    for (;;)
+    {
+        ssize_t count = read(viewer->fd, &viewer->buffer[viewer->buffered], sizeof(viewer->buffer) - viewer->buffered);
+        if (count > 0)
+        {
+            viewer->buffered += (size_t)count;
+        }
+
+        size_t offset = 0;
+        StreamHeader header;
+        while (viewer->buffered - offset >= STREAM_HEADER_SIZE)
+        {
+            if (stream_decode_header(&viewer->buffer[offset], &header) != 0)
+            {
+                return false;
+            }
+            if (viewer->buffered - offset < STREAM_HEADER_SIZE + (size_t)header.length)
+            {
+                break;
+            }
+            if (stream_apply_delta(&header, &viewer->buffer[offset + STREAM_HEADER_SIZE], viewer->rows) != 0 || header.frame <= viewer->frame)
+            {
+                return false;
+            }
+            viewer->frame = header.frame;
+            offset += STREAM_HEADER_SIZE + header.length;
+            viewer->messages++;
+        }
+        memmove(viewer->buffer, &viewer->buffer[offset], viewer->buffered - offset);
+        viewer->buffered -= offset;
+
+        if (count <= 0)
+        {
+            return true;
+        }
+    }
+}
+
+static void viewer_compare(Viewer *viewer, const Display *display)
+{
+    uint64_t expected[VM_DISPLAY_HEIGHT];
+    display_pack_rows(display, expected);
+    if (memcmp(viewer->rows, expected, sizeof(expected)) != 0)
+    {
+        viewer->mismatches++;
+    }
+}
+
+// A socket file nobody listens on, as a killed server leaves behind
+static void leave_stale_socket(const char *path)
+{
+    struct sockaddr_un socket_address = {0};
+    socket_address.sun_family = AF_UNIX;
+    snprintf(socket_address.sun_path, sizeof(socket_address.sun_path), "%s", path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    CHECK(fd >= 0 && bind(fd, (struct sockaddr *)&socket_address, sizeof(socket_address)) == 0);
+    close(fd);
+}
+
+#endif
+
+int main(int argc, char *argv[])
+{
+#ifdef _WIN32
+    (void)argc;
+    (void)argv;
+    printf("SKIP: stream loopback needs unix sockets\n");
+    return 0;
+#else
+    if (argc < 2)
+    {
+        printf("Usage: test_stream_loopback <rom>\n");
+        return 1;
+    }
+
+    char address[64];
+    snprintf(address, sizeof(address), "unix:/tmp/chip8-loopback-%ld.sock", (long)getpid());
+
+    VM *vm = vm_new();
+    vm_seed_random(vm, 1);
+    vm_memcpy(vm, 0x0, (void *)FONT_DATA, FONT_DATA_SIZE);
+    if (vm_load_program(vm, argv[1]) != 0)
+    {
+        vm_free(vm);
+        return 1;
+    }
+    vm->program_counter = 0x200;
+
+    leave_stale_socket(address + 5);
+    StreamServer *server = stream_server_open(address);
+    CHECK(server != NULL);
+    if (server == NULL)
+    {
+        unlink(address + 5);
+        vm_free(vm);
+        return 1;
+    }
+
+    // The address belongs to a running server now, a second one must not take it
+    CHECK(stream_server_open(address) == NULL);
+
+    static Viewer steady, leaving, late;
+    // Connecting completes against the listen backlog, the server accepts on its next broadcast
+    CHECK(viewer_attach(&steady, address));
+    CHECK(viewer_attach(&leaving, address));
+
+    Keyboard keyboard = {0};
+    InputQueue input = {0};
+    bool late_attached = false;
+
+    // Messages are far smaller than the socket buffer, so every broadcast has
+    // arrived by the time it returns and viewers never fall behind
+    for (int i = 0; i < LOOPBACK_FRAMES; i++)
+    {
+        if (i == LOOPBACK_LEAVE_FRAME)
+        {
+            viewer_detach(&leaving);
+        }
+        if (i == LOOPBACK_JOIN_FRAME)
+        {
+            CHECK(server->client_count == 1);
+            CHECK(viewer_attach(&late, address));
+            late_attached = true;
+            // Let the server's accept interval pass so the next broadcast picks it up
+            clock_sleep_ms(STREAM_ACCEPT_INTERVAL_MS * 2);
+        }
+
+        CHECK(vm_run_frame(vm, &keyboard, &input, LOOPBACK_INSTRUCTIONS) == VMERROR_OK);
+        stream_server_broadcast(server, &vm->display);
+
+        CHECK(viewer_drain(&steady));
+        viewer_compare(&steady, &vm->display);
+
+        if (i < LOOPBACK_LEAVE_FRAME)
+        {
+            CHECK(viewer_drain(&leaving));
+            viewer_compare(&leaving, &vm->display);
+        }
+
+        if (late_attached)
+        {
+            CHECK(viewer_drain(&late));
+            viewer_compare(&late, &vm->display);
+        }
+    }
+
+    CHECK(server->client_count == 2);
+    for (size_t i = 0; i < server->client_count; i++)
+    {
+        CHECK(server->clients[i].frames_dropped == 0);
+    }
+
+    CHECK(steady.mismatches == 0);
+    CHECK(leaving.mismatches == 0);
+    CHECK(late.mismatches == 0);
+    CHECK(steady.messages > late.messages);
+    CHECK(late.messages > 1);
+    CHECK(late.frame > LOOPBACK_JOIN_FRAME && late.frame == steady.frame);
+
+    stream_server_close(server);
+    CHECK(viewer_drain(&steady) && viewer_drain(&late));
+    CHECK(access(address + 5, F_OK) != 0);
+
+    viewer_detach(&steady);
+    viewer_detach(&late);
+    vm_free(vm);
+    return check_result("stream loopback");
+#endif
+}
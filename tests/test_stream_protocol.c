@@ -0,0 +1,200 @@
+// Round trips of the XOR delta and PackBits coding in StreamProtocol.c
+
+#include <string.h>
+
+#include "Check.h"
+#include "Stream/StreamProtocol.h"
+
+static uint32_t noise_state = 0x2545F491;
+
+// xorshift32, with every byte different from its neighbour so noise never forms a run
+static uint8_t noise_byte(uint8_t previous)
+{
+    uint8_t value;
+    do
+    {
+        noise_state ^= noise_state << 13;
+        noise_state ^= noise_state >> 17;
+        noise_state ^= noise_state << 5;
+        value = (uint8_t)noise_state;
+    } while (value == previous);
+    return value;
+}
+
+// Fills rows so the bytes of their delta against zero are `bytes`, rows in order
+static void rows_from_bytes(const uint8_t *bytes, size_t length, uint64_t rows[VM_DISPLAY_HEIGHT])
+{
+    memset(rows, 0, VM_DISPLAY_HEIGHT * sizeof(uint64_t));
+    for (size_t i = 0; i < length; i++)
+    {
+        rows[i / STREAM_ROW_BYTES] |= (uint64_t)bytes[i] << (i % STREAM_ROW_BYTES * 8);
+    }
+}
+
+// Encodes rows against base, decodes the message onto a copy of base and
+// returns the payload length, or -1 if the result isn't rows
+static int round_trip(const uint64_t base[VM_DISPLAY_HEIGHT], const uint64_t rows[VM_DISPLAY_HEIGHT], uint32_t frame)
+{
+    uint8_t message[STREAM_MESSAGE_MAX];
+    size_t length = stream_encode_delta(base, rows, frame, message);
+
+    StreamHeader header;
+    if (length < STREAM_HEADER_SIZE || length > STREAM_MESSAGE_MAX || stream_decode_header(message, &header) != 0)
+    {
+        return -1;
+    }
+    if (header.frame != frame || header.length != length - STREAM_HEADER_SIZE)
+    {
+        return -1;
+    }
+
+    uint64_t decoded[VM_DISPLAY_HEIGHT];
+    memcpy(decoded, base, sizeof(decoded));
+    if (stream_apply_delta(&header, &message[STREAM_HEADER_SIZE], decoded) != 0)
+    {
+        return -1;
+    }
+
+    return memcmp(decoded, rows, sizeof(decoded)) == 0 ? header.length : -1;
+}
+
+static void test_empty_frame(void)
+{
+    uint64_t rows[VM_DISPLAY_HEIGHT] = {0};
+    CHECK(round_trip(rows, rows, 1) == 0);
+
+    for (int y = 0; y < VM_DISPLAY_HEIGHT; y++)
+    {
+        rows[y] = (uint64_t)(y + 1) * UINT64_C(0x0123456789ABCDEF);
+    }
+    CHECK(round_trip(rows, rows, 2) == 0);
+}
+
+static void test_all_different(void)
+{
+    uint64_t base[VM_DISPLAY_HEIGHT] = {0};
+    uint64_t rows[VM_DISPLAY_HEIGHT];
+
+    // Every pixel flips: one long run, split at 128 bytes
+    memset(rows, 0xFF, sizeof(rows));
+    CHECK(round_trip(base, rows, 3) == 4);
+
+    // Every row changes and no bytes repeat: literals only, the worst case
+    uint8_t bytes[VM_DISPLAY_HEIGHT * STREAM_ROW_BYTES];
+    uint8_t previous = 0;
+    for (size_t i = 0; i < sizeof(bytes); i++)
+    {
+        bytes[i] = previous = noise_byte(previous);
+    }
+    rows_from_bytes(bytes, sizeof(bytes), rows);
+    int length = round_trip(base, rows, 4);
+    CHECK(length == (int)sizeof(bytes) + 2);
+    CHECK(length <= STREAM_PAYLOAD_MAX);
+
+    // Against a non blank base
+    memcpy(base, rows, sizeof(base));
+    for (int y = 0; y < VM_DISPLAY_HEIGHT; y++)
+    {
+        rows[y] = ~base[y];
+    }
+    CHECK(round_trip(base, rows, 5) == 4);
+}
+
+// A run of `run` equal bytes followed by literal bytes, up to a row boundary
+static int run_then_noise(size_t run)
+{
+    uint8_t bytes[VM_DISPLAY_HEIGHT * STREAM_ROW_BYTES];
+    size_t length = (run + 1 + STREAM_ROW_BYTES - 1) / STREAM_ROW_BYTES * STREAM_ROW_BYTES;
+
+    memset(bytes, 0xA5, run);
+    uint8_t previous = 0xA5;
+    for (size_t i = run; i < length; i++)
+    {
+        bytes[i] = previous = noise_byte(previous);
+    }
+
+    uint64_t base[VM_DISPLAY_HEIGHT] = {0};
+    uint64_t rows[VM_DISPLAY_HEIGHT];
+    rows_from_bytes(bytes, length, rows);
+    return round_trip(base, rows, (uint32_t)run);
+}
+
+// A literal stretch of `literal` bytes followed by a run up to a row boundary
+static int noise_then_run(size_t literal)
+{
+    uint8_t bytes[VM_DISPLAY_HEIGHT * STREAM_ROW_BYTES];
+    size_t length = (literal + 3 + STREAM_ROW_BYTES - 1) / STREAM_ROW_BYTES * STREAM_ROW_BYTES;
+
+    uint8_t previous = 0x5A;
+    for (size_t i = 0; i < literal; i++)
+    {
+        do
+        {
+            bytes[i] = noise_byte(previous);
+        } while (bytes[i] == 0x5A);
+        previous = bytes[i];
+    }
+    memset(&bytes[literal], 0x5A, length - literal);
+
+    uint64_t base[VM_DISPLAY_HEIGHT] = {0};
+    uint64_t rows[VM_DISPLAY_HEIGHT];
+    rows_from_bytes(bytes, length, rows);
+    return round_trip(base, rows, (uint32_t)literal);
+}
+
+static void test_run_limits(void)
+{
+    // 128 fits a single repeat, 129 needs a second packet
+    CHECK(run_then_noise(127) != -1);
+    CHECK(run_then_noise(128) != -1);
+    CHECK(run_then_noise(129) != -1);
+    CHECK(run_then_noise(256 - 1) != -1);
+
+    uint64_t base[VM_DISPLAY_HEIGHT] = {0};
+    uint64_t rows[VM_DISPLAY_HEIGHT] = {0};
+    for (int y = 0; y < 16; y++)
+    {
+        rows[y] = UINT64_C(0xA5A5A5A5A5A5A5A5);
+    }
+    CHECK(round_trip(base, rows, 6) == 2);
+
+    rows[16] = 0xA5;
+    CHECK(round_trip(base, rows, 7) == 2 + 2 + 2);
+
+    CHECK(noise_then_run(127) != -1);
+    CHECK(noise_then_run(128) != -1);
+    CHECK(noise_then_run(129) != -1);
+}
+
+static void test_malformed(void)
+{
+    uint64_t base[VM_DISPLAY_HEIGHT] = {0};
+    uint64_t rows[VM_DISPLAY_HEIGHT];
+    memset(rows, 0x3C, sizeof(rows));
+
+    uint8_t message[STREAM_MESSAGE_MAX];
+    stream_encode_delta(base, rows, 8, message);
+    StreamHeader header;
+    CHECK(stream_decode_header(message, &header) == 0);
+
+    // A truncated payload or a row mask that doesn't match it must be rejected
+    StreamHeader truncated = header;
+    truncated.length--;
+    CHECK(stream_apply_delta(&truncated, &message[STREAM_HEADER_SIZE], base) != 0);
+
+    StreamHeader extra_row = header;
+    extra_row.row_mask = 0x7FFFFFFF;
+    CHECK(stream_apply_delta(&extra_row, &message[STREAM_HEADER_SIZE], base) != 0);
+
+    message[0] ^= 1;
+    CHECK(stream_decode_header(message, &header) != 0);
+}
+
+int main(void)
+{
+    test_empty_frame();
+    test_all_different();
+    test_run_limits();
+    test_malformed();
+    return check_result("stream protocol");
+}